@@ -26,26 +26,62 @@
 #include <string>
 #include <fstream>
 #include <map>
+#include <set>
 #include <stdexcept>
+#include <algorithm>
+#include <utility>
 #include "zlib.h"
 #include "rapidxml/rapidxml.hpp"
 #include "PVRIptvData.h"
+#include "PVRIptvDecompressor.h"
+#include "PVRIptvFileWatcher.h"
+#include "PVRIptvHttp.h"
+#include "PVRIptvJob.h"
+#include "PVRIptvM3uTokenizer.h"
+#include "PVRIptvSnapshot.h"
+#include "PVRIptvXtream.h"
 #include "p8-platform/util/StringUtils.h"
+#include "p8-platform/util/timeutils.h"
 
 #define M3U_START_MARKER        "#EXTM3U"
 #define M3U_INFO_MARKER         "#EXTINF"
-#define TVG_INFO_ID_MARKER      "tvg-id="
-#define TVG_INFO_NAME_MARKER    "tvg-name="
-#define TVG_INFO_LOGO_MARKER    "tvg-logo="
-#define TVG_INFO_SHIFT_MARKER   "tvg-shift="
-#define TVG_INFO_CHNO_MARKER    "tvg-chno="
-#define GROUP_NAME_MARKER       "group-title="
-#define RADIO_MARKER            "radio="
 #define CHANNEL_LOGO_EXTENSION  ".png"
 #define SECONDS_IN_DAY          86400
 #define GENRES_MAP_FILENAME     "genres.xml"
 
+#define EPG_RETRY_BASE_DELAY_MS       2000    // first retry after 2 sec
+#define EPG_RETRY_MAX_DELAY_MS        300000  // never wait more than 5 min between tries
+#define EPG_CIRCUIT_BREAKER_FAILURES  5       // consecutive failures before giving up for a while
+#define EPG_CIRCUIT_BREAKER_COOLDOWN  1800    // seconds to serve the last good EPG only
+#define BACKGROUND_SLICE_MS           50      // work done between two yields
+#define EPG_PRELOAD_PAST_DAYS         1       // guide window loaded at start up
+#define EPG_PRELOAD_FUTURE_DAYS       7
+#define EPG_SOURCES_SEPARATOR         "|"
+#define M3U_SOURCES_SEPARATOR         "|"
+#define EPG_UNPACK_MAX_LAYERS         3       // e.g. tar, then a packed guide inside
+#define EPG_TVG_ID_PLACEHOLDER        "{tvg-id}"
+#define EPG_CHANNEL_MAX_WORKERS       4       // per channel guides downloaded at once
+#define XTREAM_MAX_WORKERS            4       // categories downloaded at once
+#define FILE_WATCH_INTERVAL_MS        5000    // local files are checked this often
+#define FILE_WATCH_PLAYLIST           0       // tags of watched files, guides follow with their index
+#define FILE_WATCH_GENRES             1
+#define FILE_WATCH_EPG                2
+#define FILE_READ_SIZE                (64 * 1024)
+#define CACHE_HASH_EXTENSION          ".hash"
+#define CACHE_TEMP_EXTENSION          ".tmp"
+#define CACHE_HTTP_EXTENSION          ".http"
+#define CACHE_PART_EXTENSION          ".part"
+#define HTTP_STATUS_OK                200
+#define HTTP_STATUS_PARTIAL_CONTENT   206
+#define HTTP_STATUS_NOT_MODIFIED      304
+#define CHANNELS_SNAPSHOT_NAME        M3U_FILE_PREFIX "channels.snapshot"
+#define M3U_PARSE_CHUNK_SIZE          (4 * 1024 * 1024)  // smallest part of a playlist parsed by its own thread
+#define CHANNEL_ID_NAME_AND_URL       0       // legacy ids, kept as default so Kodi databases stay valid
+#define CHANNEL_ID_TVG_ID             1
+#define CHANNEL_ID_NAME               2
+
 using namespace ADDON;
+using namespace P8PLATFORM;
 using namespace rapidxml;
 
 template<class Ch>
@@ -60,6 +96,317 @@ inline bool GetNodeValue(const xml_node<Ch> * pRootNode, const char* strTag, std
   return true;
 }
 
+/*
+ * 64 bit FNV-1a, cheap enough for every line of a playlist.
+ */
+static uint64_t HashString64(const char *strValue, size_t iLength)
+{
+  uint64_t iHash = 14695981039346656037ULL;
+  for (size_t i = 0; i < iLength; i++)
+  {
+    iHash ^= (unsigned char)strValue[i];
+    iHash *= 1099511628211ULL;
+  }
+  return iHash;
+}
+
+/*
+ * FNV-1a over little endian 64 bit words, fed block by block while a file
+ * is read. Blocks may have any size, the result only depends on the data.
+ */
+class PVRIptvContentHasher
+{
+public:
+  PVRIptvContentHasher(void) : m_iHash(14695981039346656037ULL), m_iWord(0), m_iFill(0), m_iLength(0) {}
+
+  void Update(const char *pData, size_t iLength)
+  {
+    const unsigned char *p = (const unsigned char *)pData;
+    m_iLength += iLength;
+
+    // finish the word left over by the previous block
+    while (iLength > 0 && m_iFill != 0)
+    {
+      AddByte(*p++);
+      iLength--;
+    }
+
+    for (; iLength >= 8; p += 8, iLength -= 8)
+    {
+      Mix((uint64_t)p[0]         | (uint64_t)p[1] << 8  | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+          (uint64_t)p[4] << 32   | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56);
+    }
+
+    while (iLength > 0)
+    {
+      AddByte(*p++);
+      iLength--;
+    }
+  }
+
+  uint64_t Final(void) const
+  {
+    uint64_t iHash = m_iHash;
+    if (m_iFill != 0)
+    {
+      iHash ^= m_iWord;
+      iHash *= 1099511628211ULL;
+    }
+    iHash ^= m_iLength;
+    iHash *= 1099511628211ULL;
+    return iHash;
+  }
+
+private:
+  void AddByte(unsigned char c)
+  {
+    m_iWord |= (uint64_t)c << (8 * m_iFill);
+    if (++m_iFill == 8)
+    {
+      Mix(m_iWord);
+      m_iWord = 0;
+      m_iFill = 0;
+    }
+  }
+
+  void Mix(uint64_t iWord)
+  {
+    m_iHash ^= iWord;
+    m_iHash *= 1099511628211ULL;
+  }
+
+  uint64_t     m_iHash;
+  uint64_t     m_iWord;
+  unsigned int m_iFill;
+  uint64_t     m_iLength;
+};
+
+/*
+ * Channel ids are positive 31 bit values, Kodi keeps them in its databases.
+ */
+static int FoldChannelId(uint64_t iHash)
+{
+  int iId = (int)((iHash ^ (iHash >> 32)) & 0x7FFFFFFF);
+  return iId == 0 ? 1 : iId;
+}
+
+static int NextChannelId(int iId)
+{
+  return (iId % 0x7FFFFFFF) + 1;
+}
+
+/*
+ * Playlists are checked for UTF-8 once, Kodi only converts the fields
+ * of those that are not.
+ */
+static void AssignUTF8(std::string &strOut, const PVRIptvStringRef &value, bool bConvert)
+{
+  if (!bConvert || value.empty())
+  {
+    strOut.assign(value.pData, value.iLength);
+    return;
+  }
+
+  std::string strValue = value.str();
+  char *strConverted = XBMC->UnknownToUTF8(strValue.c_str());
+  if (strConverted)
+  {
+    strOut = strConverted;
+    XBMC->FreeString(strConverted);
+  }
+  else
+  {
+    strOut.swap(strValue);
+  }
+}
+
+/*
+ * Kodi takes the mime type of a stream from the channel, it doesn't need
+ * to probe the stream then.
+ */
+static std::string GetInputFormat(const PVRIptvM3uProperties &properties)
+{
+  if (!properties.strMimeType.empty())
+    return properties.strMimeType.str();
+  if (properties.strManifestType.Equals("hls", 3))
+    return "application/x-mpegURL";
+  if (properties.strManifestType.Equals("mpd", 3))
+    return "application/dash+xml";
+  if (properties.strManifestType.Equals("ism", 3))
+    return "application/vnd.ms-sstr+xml";
+
+  return "";
+}
+
+/*
+ * HTTP options are passed the Kodi way: url|User-Agent=...&Referer=...
+ */
+static void AppendUrlOption(std::string &strUrl, const char *strName, const PVRIptvStringRef &value)
+{
+  if (value.empty())
+    return;
+
+  strUrl += strUrl.find('|') == std::string::npos ? '|' : '&';
+  strUrl += strName;
+  strUrl += '=';
+  PVRIptvHttp::AppendEncoded(strUrl, value.pData, value.iLength);
+}
+
+/*
+ * Everything Kodi or the guide lookup gets from a channel, logo paths are
+ * left out as the guide may have replaced them.
+ */
+static bool IsSameChannel(const PVRIptvChannel &left, const PVRIptvChannel &right)
+{
+  return left.bRadio            == right.bRadio
+      && left.bHasTvgId         == right.bHasTvgId
+      && left.iChannelNumber    == right.iChannelNumber
+      && left.iEncryptionSystem == right.iEncryptionSystem
+      && left.iTvgShift         == right.iTvgShift
+      && left.strChannelName    == right.strChannelName
+      && left.strStreamURL      == right.strStreamURL
+      && left.strInputFormat    == right.strInputFormat
+      && left.strTvgId          == right.strTvgId
+      && left.strTvgName        == right.strTvgName
+      && left.strTvgLogo        == right.strTvgLogo;
+}
+
+static bool ChannelsDiffer(const std::vector<PVRIptvChannel> &oldChannels, const PVRIptvChannelIndex &oldIndex,
+                           const std::vector<PVRIptvChannel> &newChannels)
+{
+  if (oldChannels.size() != newChannels.size())
+    return true;
+
+  std::vector<PVRIptvChannel>::const_iterator channel;
+  for (channel = newChannels.begin(); channel != newChannels.end(); ++channel)
+  {
+    PVRIptvChannelIndex::const_iterator it = oldIndex.find(channel->iUniqueId);
+    if (it == oldIndex.end() || !IsSameChannel(oldChannels.at(it->second), *channel))
+      return true;
+  }
+
+  return false;
+}
+
+static bool GroupsDiffer(const std::vector<PVRIptvChannelGroup> &oldGroups, const std::vector<PVRIptvChannel> &oldChannels,
+                         const std::vector<PVRIptvChannelGroup> &newGroups, const std::vector<PVRIptvChannel> &newChannels)
+{
+  if (oldGroups.size() != newGroups.size())
+    return true;
+
+  for (size_t iGroup = 0; iGroup < newGroups.size(); iGroup++)
+  {
+    const PVRIptvChannelGroup &oldGroup = oldGroups[iGroup];
+    const PVRIptvChannelGroup &newGroup = newGroups[iGroup];
+    if (oldGroup.iGroupId != newGroup.iGroupId || oldGroup.bRadio != newGroup.bRadio
+        || oldGroup.strGroupName != newGroup.strGroupName || oldGroup.members.size() != newGroup.members.size())
+      return true;
+
+    // members are positions in their own channel list, compare the ids
+    for (size_t iMember = 0; iMember < newGroup.members.size(); iMember++)
+    {
+      if (oldChannels.at(oldGroup.members[iMember]).iUniqueId != newChannels.at(newGroup.members[iMember]).iUniqueId)
+        return true;
+    }
+  }
+
+  return false;
+}
+
+static bool EpgEntryStartsBefore(const PVRIptvEpgEntry &left, const PVRIptvEpgEntry &right)
+{
+  return left.startTime < right.startTime;
+}
+
+/*
+ * Checks entry against the first iCount entries, those must be sorted
+ * by start time and must not overlap each other.
+ */
+static bool EpgEntryOverlaps(const std::vector<PVRIptvEpgEntry> &entries, size_t iCount, const PVRIptvEpgEntry &entry)
+{
+  PVRIptvEpgEntry key;
+  key.startTime = entry.endTime;
+
+  std::vector<PVRIptvEpgEntry>::const_iterator it =
+    std::lower_bound(entries.begin(), entries.begin() + iCount, key, EpgEntryStartsBefore);
+
+  return it != entries.begin() && (it - 1)->endTime > entry.startTime;
+}
+
+/*
+ * Fingerprint of what Kodi shows for a channel, broadcast ids are left out
+ * as they are renumbered on every merge
+ */
+static void HashEpgString(PVRIptvContentHasher &hasher, const std::string &strValue)
+{
+  uint64_t iLength = strValue.size();
+  hasher.Update((const char *)&iLength, sizeof(iLength));
+  hasher.Update(strValue.c_str(), strValue.size());
+}
+
+static uint64_t HashEpgChannel(const PVRIptvEpgChannel *epg)
+{
+  if (epg == NULL)
+    return 0;
+
+  PVRIptvContentHasher hasher;
+  std::vector<PVRIptvEpgEntry>::const_iterator it;
+  for (it = epg->epg.begin(); it != epg->epg.end(); ++it)
+  {
+    int64_t times[2] = { (int64_t)it->startTime, (int64_t)it->endTime };
+    hasher.Update((const char *)times, sizeof(times));
+    HashEpgString(hasher, it->strTitle);
+    HashEpgString(hasher, it->strPlotOutline);
+    HashEpgString(hasher, it->strPlot);
+    HashEpgString(hasher, it->strIconPath);
+    HashEpgString(hasher, it->strGenreString);
+  }
+  return hasher.Final();
+}
+
+/*
+ * Caches are named after their source, so an edited or reordered source
+ * list never serves the copy of another source
+ */
+static std::string GetCacheName(const char *strPrefix, const std::string &strUrl, const char *strExtension)
+{
+  return StringUtils::Format("%s%016llx%s", strPrefix,
+                             (unsigned long long)HashString64(strUrl.c_str(), strUrl.size()), strExtension);
+}
+
+static std::string GetEPGCacheName(const std::string &strXMLTVUrl)
+{
+  return GetCacheName(TVG_FILE_PREFIX, strXMLTVUrl, ".xml.cache");
+}
+
+static std::string GetEPGChannelCacheName(const std::string &strTemplate, const std::string &strTvgId)
+{
+  return GetCacheName(TVG_FILE_PREFIX, strTemplate, StringUtils::Format(".%016llx.xml.cache",
+                      (unsigned long long)HashString64(strTvgId.c_str(), strTvgId.size())).c_str());
+}
+
+/*
+ * Per channel guides are fetched from a template, e.g. http://host/epg/{tvg-id}.xml
+ */
+static bool IsEPGTemplate(const std::string &strXMLTVUrl)
+{
+  return strXMLTVUrl.find(EPG_TVG_ID_PLACEHOLDER) != std::string::npos;
+}
+
+static std::string GetEPGChannelUrl(const std::string &strTemplate, const std::string &strTvgId)
+{
+  // local paths take the id as it is
+  std::string strId;
+  if (PVRIptvMappedFile::IsLocalPath(strTemplate))
+    strId = strTvgId;
+  else
+    PVRIptvHttp::AppendEncoded(strId, strTvgId.c_str(), strTvgId.size());
+
+  std::string strUrl = strTemplate;
+  StringUtils::Replace(strUrl, EPG_TVG_ID_PLACEHOLDER, strId);
+  return strUrl;
+}
+
 template<class Ch>
 inline bool GetAttributeValue(const xml_node<Ch> * pNode, const char* strAttributeName, std::string& strStringValue)
 {
@@ -82,422 +429,1742 @@ PVRIptvData::PVRIptvData(void)
   m_iLastStart    = 0;
   m_iLastEnd      = 0;
 
+  m_iPlaylistKey        = 0;
+  m_iChannelsGeneration = 0;
+  m_bGenresLoaded       = false;
+  m_bWatchesChanged     = true;
+
+  m_bEPGLoadRequested    = false;
+  m_iEPGFailures         = 0;
+  m_iEPGNextAttempt      = 0;
+  m_iEPGCircuitOpenUntil = 0;
+
+  m_iCpuBudget       = std::max(10, std::min(100, g_iBackgroundCpuBudget));
+  m_bPauseOnPlayback = g_bPauseOnPlayback;
+  m_bPowerSaving     = false;
+  m_bPlaying         = false;
+  m_bPlaylistLoaded  = false;
+  m_filter.Load(g_strM3UIncludeFilter, g_strM3UExcludeFilter);
+  m_refreshPool      = new PVRIptvJobPool(1);
+  m_cacheWritePool   = new PVRIptvJobPool(1);
+
   m_channels.clear();
   m_groups.clear();
+  m_groupIndex.clear();
+  m_channelIndex.clear();
   m_epg.clear();
   m_genres.clear();
+  SetEPGSources();
 
-  if (LoadPlayList())
-    XBMC->QueueNotification(QUEUE_INFO, "%d channels loaded.", m_channels.size());
+  // playlist and guide are loaded in background, see InitialLoad()
+  CreateThread(false);
 }
 
-void *PVRIptvData::Process(void)
+class PVRIptvEpgLoadJob : public PVRIptvJob
 {
-  return NULL;
-}
+public:
+  PVRIptvEpgLoadJob(PVRIptvData &data, time_t iStart, time_t iEnd)
+    : m_data(data), m_iStart(iStart), m_iEnd(iEnd), m_bResult(false) {}
 
-PVRIptvData::~PVRIptvData(void)
+  virtual void Run(void)
+  {
+    m_bResult = m_data.LoadEPG(m_iStart, m_iEnd);
+  }
+
+  PVRIptvData &m_data;
+  time_t       m_iStart;
+  time_t       m_iEnd;
+  bool         m_bResult;
+};
+
+class PVRIptvEpgSourceJob : public PVRIptvJob
 {
-  m_channels.clear();
-  m_groups.clear();
-  m_epg.clear();
-  m_genres.clear();
-}
+public:
+  PVRIptvEpgSourceJob(PVRIptvData &data, size_t iSource, const std::string &strXMLTVUrl, time_t iStart, time_t iEnd)
+    : m_data(data), m_iSource(iSource), m_strXMLTVUrl(strXMLTVUrl), m_iStart(iStart), m_iEnd(iEnd), m_bResult(false) {}
 
-bool PVRIptvData::LoadEPG(time_t iStart, time_t iEnd)
+  virtual void Run(void)
+  {
+    m_bResult = m_data.LoadEPGSource(m_iSource, m_strXMLTVUrl, m_iStart, m_iEnd);
+  }
+
+  PVRIptvData &m_data;
+  size_t       m_iSource;
+  std::string  m_strXMLTVUrl;
+  time_t       m_iStart;
+  time_t       m_iEnd;
+  bool         m_bResult;
+};
+
+class PVRIptvEpgChannelJob : public PVRIptvJob
 {
-  if (m_strXMLTVUrl.empty())
+public:
+  PVRIptvEpgChannelJob(PVRIptvData &data, const std::string &strCachedName, const std::string &strXMLTVUrl)
+    : m_data(data), m_strCachedName(strCachedName), m_strXMLTVUrl(strXMLTVUrl), m_iHash(0), m_bExpired(false),
+      m_bResult(false) {}
+
+  // a guide that was not unpacked still goes to its cache
+  virtual ~PVRIptvEpgChannelJob(void) { m_data.ReleaseCachedFile(m_strCachedName, m_strData); }
+
+  virtual void Run(void)
   {
-    XBMC->Log(LOG_NOTICE, "EPG file path is not configured. EPG not loaded.");
-    return false;
+    if (!m_data.IsStopped())
+      m_bResult = m_data.FetchEPG(m_strCachedName, m_strXMLTVUrl, m_strData, m_iHash, &m_bExpired);
   }
 
-  std::string data;
-  std::string decompressed;
-  int iReaded = 0;
+  PVRIptvData &m_data;
+  std::string  m_strCachedName;
+  std::string  m_strXMLTVUrl;
+  std::string  m_strData;
+  uint64_t     m_iHash;
+  bool         m_bExpired;
+  bool         m_bResult;
+};
+
+/*
+ * Replaces an expired cache file in background, the job is queued and
+ * forgotten, it deletes itself when done.
+ */
+class PVRIptvCacheRefreshJob : public PVRIptvJob
+{
+public:
+  PVRIptvCacheRefreshJob(PVRIptvData &data, const std::string &strCachedName, const std::string &strFilePath,
+                         PVRIptvCacheType cacheType)
+    : m_data(data), m_strCachedName(strCachedName), m_strFilePath(strFilePath), m_cacheType(cacheType) {}
 
-  int iCount = 0;
-  while(iCount < 3) // max 3 tries
+  virtual void Run(void)
   {
-    if ((iReaded = GetCachedFileContents(TVG_FILE_NAME, m_strXMLTVUrl, data, g_bCacheEPG)) != 0)
-    {
-      break;
-    }
-    XBMC->Log(LOG_ERROR, "Unable to load EPG file '%s':  file is missing or empty. :%dth try.", m_strXMLTVUrl.c_str(), ++iCount);
-    if (iCount < 3)
-    {
-      usleep(2 * 1000 * 1000); // sleep 2 sec before next try.
-    }
+    m_data.RefreshCachedFile(m_strCachedName, m_strFilePath, m_cacheType);
+    delete this;
+  }
+
+  PVRIptvData      &m_data;
+  std::string       m_strCachedName;
+  std::string       m_strFilePath;
+  PVRIptvCacheType  m_cacheType;
+};
+
+/*
+ * Replaces one of a batch of expired cache files
+ */
+class PVRIptvCacheUpdateJob : public PVRIptvJob
+{
+public:
+  PVRIptvCacheUpdateJob(PVRIptvData &data, const std::string &strCachedName, const std::string &strFilePath)
+    : m_data(data), m_strCachedName(strCachedName), m_strFilePath(strFilePath), m_bChanged(false) {}
+
+  virtual void Run(void)
+  {
+    if (!m_data.IsStopped())
+      m_data.UpdateCachedFile(m_strCachedName, m_strFilePath, m_bChanged);
+  }
+
+  PVRIptvData &m_data;
+  std::string  m_strCachedName;
+  std::string  m_strFilePath;
+  bool         m_bChanged;
+};
+
+/*
+ * Replaces the expired files of a per channel guide template in
+ * background, queued and forgotten like PVRIptvCacheRefreshJob.
+ */
+class PVRIptvCacheBatchRefreshJob : public PVRIptvJob
+{
+public:
+  PVRIptvCacheBatchRefreshJob(PVRIptvData &data, const std::string &strBatchName,
+                              const std::vector<std::string> &cachedNames, const std::vector<std::string> &filePaths)
+    : m_data(data), m_strBatchName(strBatchName), m_cachedNames(cachedNames), m_filePaths(filePaths) {}
+
+  virtual void Run(void)
+  {
+    m_data.RefreshCachedFiles(m_strBatchName, m_cachedNames, m_filePaths);
+    delete this;
   }
 
-  if (iReaded == 0)
+  PVRIptvData              &m_data;
+  std::string               m_strBatchName;
+  std::vector<std::string>  m_cachedNames;
+  std::vector<std::string>  m_filePaths;
+};
+
+/*
+ * Writes through a temporary file, the current one may be mapped by a
+ * running load, so it is swapped in whole
+ */
+static bool ReplaceFileContents(const std::string &strPath, const std::string &strData)
+{
+  std::string strTempPath = strPath + CACHE_TEMP_EXTENSION;
+  void* fileHandle = XBMC->OpenFileForWrite(strTempPath.c_str(), true);
+  if (fileHandle == NULL)
+    return false;
+
+  bool bWritten = XBMC->WriteFile(fileHandle, strData.c_str(), strData.length()) == (ssize_t)strData.length();
+  XBMC->CloseFile(fileHandle);
+  if (!bWritten || !PVRIptvMappedFile::Replace(strTempPath, strPath))
   {
-    XBMC->Log(LOG_ERROR, "Unable to load EPG file '%s':  file is missing or empty. After %d tries.", m_strXMLTVUrl.c_str(), iCount);
+    XBMC->DeleteFile(strTempPath.c_str());
     return false;
   }
 
-  char * buffer;
+  return true;
+}
 
-  // gzip packed
-  if (data[0] == '\x1F' && data[1] == '\x8B' && data[2] == '\x08')
+/*
+ * Writes a cache file in background, the loads go on with the contents
+ * they already have. The job owns what it writes, the packed copy, or the
+ * contents themselves once the load is done with them.
+ */
+class PVRIptvCacheWriteJob : public PVRIptvJob
+{
+public:
+  PVRIptvCacheWriteJob(PVRIptvData &data, const std::string &strCachedPath, std::string &strData,
+                       uint64_t iHash, bool bUnchanged, const PVRIptvHttpValidators &validators,
+                       unsigned int iSequence)
+    : m_data(data), m_strCachedPath(strCachedPath), m_iHash(iHash), m_bUnchanged(bUnchanged),
+      m_validators(validators), m_iSequence(iSequence)
   {
-    if (!GzipInflate(data, decompressed))
-    {
-      XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': unable to decompress file.", m_strXMLTVUrl.c_str());
-      return false;
-    }
-    buffer = &(decompressed[0]);
+    m_strData.swap(strData);
   }
-  else
-    buffer = &(data[0]);
 
-  // xml should starts with '<?xml'
-  if (buffer[0] != '\x3C' || buffer[1] != '\x3F' || buffer[2] != '\x78' ||
-      buffer[3] != '\x6D' || buffer[4] != '\x6C')
+  virtual void Run(void)
+  {
+    m_data.WriteCacheData(m_strCachedPath, m_strData, m_iHash, m_bUnchanged, m_validators, m_iSequence);
+    delete this;
+  }
+
+  PVRIptvData           &m_data;
+  std::string            m_strCachedPath;
+  std::string            m_strData;
+  uint64_t               m_iHash;
+  bool                   m_bUnchanged;
+  PVRIptvHttpValidators  m_validators;
+  unsigned int           m_iSequence;
+};
+
+/*
+ * Writes the channels snapshot in background, on the cache writer so
+ * snapshots land in the order they were made.
+ */
+class PVRIptvSnapshotWriteJob : public PVRIptvJob
+{
+public:
+  PVRIptvSnapshotWriteJob(const std::string &strSnapshotPath, std::string &strSnapshot)
+    : m_strSnapshotPath(strSnapshotPath)
+  {
+    m_strSnapshot.swap(strSnapshot);
+  }
+
+  virtual void Run(void)
+  {
+    if (!ReplaceFileContents(m_strSnapshotPath, m_strSnapshot))
+      XBMC->Log(LOG_ERROR, "Unable to write channels snapshot '%s'.", m_strSnapshotPath.c_str());
+    delete this;
+  }
+
+  std::string  m_strSnapshotPath;
+  std::string  m_strSnapshot;
+};
+
+void PVRIptvData::InitialLoad(void)
+{
+  CLockObject lock(m_mutex);
+  time_t iNow = time(NULL);
+  m_iLastStart = iNow - EPG_PRELOAD_PAST_DAYS * SECONDS_IN_DAY;
+  m_iLastEnd   = iNow + EPG_PRELOAD_FUTURE_DAYS * SECONDS_IN_DAY;
+  lock.Unlock();
+
+  // guide downloads don't need channels, start them right away
+  PVRIptvEpgLoadJob epgJob(*this, m_iLastStart, m_iLastEnd);
+  PVRIptvJobPool pool(1);
+  pool.Add(&epgJob);
+
+  bool bChannelsChanged, bGroupsChanged;
+  if (LoadPlayList(bChannelsChanged, bGroupsChanged))
+  {
+    XBMC->QueueNotification(QUEUE_INFO, "%d channels loaded.", GetChannelsAmount());
+    if (bChannelsChanged)
+      PVR->TriggerChannelUpdate();
+    if (bGroupsChanged)
+      PVR->TriggerChannelGroupsUpdate();
+  }
+
+  lock.Lock();
+  m_bPlaylistLoaded = true;
+  m_playlistEvent.Broadcast();
+  lock.Unlock();
+
+  pool.Wait();
+  if (epgJob.m_bResult || IsStopped())
+    return;
+
+  lock.Lock();
+  ScheduleEPGRetry();
+}
+
+void PVRIptvData::WaitForPlaylist(void)
+{
+  CLockObject lock(m_mutex);
+  while (!m_bPlaylistLoaded && !IsStopped())
+  {
+    lock.Unlock();
+    m_playlistEvent.Wait(100);
+    lock.Lock();
+  }
+}
+
+void *PVRIptvData::Process(void)
+{
+  SetBackgroundThreadPriority();
+  UpdateFileWatches();
+  InitialLoad();
+
+  while (!IsStopped())
   {
-    // check for BOM
-    if (buffer[0] != '\xEF' || buffer[1] != '\xBB' || buffer[2] != '\xBF')
+    if (!IsBackgroundWorkPaused())
+      CheckWatchedFiles();
+
+    time_t iStart, iEnd;
+    bool bIdle = false;
+    bool bPaused = false;
+    uint64_t iWaitMs = 0;
+    uint64_t iMaxWaitMs = m_watcher.IsEmpty() ? EPG_RETRY_MAX_DELAY_MS : FILE_WATCH_INTERVAL_MS;
     {
-      // check for tar archive
-      if (strcmp(buffer + 0x101, "ustar") || strcmp(buffer + 0x101, "GNUtar"))
-        buffer += 0x200; // RECORDSIZE = 512
+      CLockObject lock(m_mutex);
+      uint64_t iNow = GetTimeMs();
+      time_t iTime = time(NULL);
+
+      if (!m_bEPGLoadRequested)
+        bIdle = true;
+      else if (m_iEPGCircuitOpenUntil > iTime)
+        iWaitMs = (uint64_t)(m_iEPGCircuitOpenUntil - iTime) * 1000;
+      else if (m_iEPGNextAttempt > iNow)
+        iWaitMs = m_iEPGNextAttempt - iNow;
+      else if (IsBackgroundWorkPaused())
+        bPaused = true;  // the request stays pending until work resumes
       else
       {
-        XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': unable to parse file.", m_strXMLTVUrl.c_str());
-        return false;
+        m_bEPGLoadRequested = false;
+        iStart = m_iLastStart;
+        iEnd   = m_iLastEnd;
       }
     }
+
+    if (bIdle)
+    {
+      if (m_watcher.IsEmpty())
+        m_epgLoadEvent.Wait();
+      else
+        m_epgLoadEvent.Wait(FILE_WATCH_INTERVAL_MS);
+      continue;
+    }
+    if (bPaused)
+    {
+      m_resumeEvent.Wait(1000);
+      continue;
+    }
+    if (iWaitMs > 0)
+    {
+      // woken up early by new requests or on exit, the schedule is re-checked
+      m_epgLoadEvent.Wait((uint32_t)std::min<uint64_t>(iWaitMs, iMaxWaitMs));
+      continue;
+    }
+
+    if (LoadEPG(iStart, iEnd))
+    {
+      CLockObject lock(m_mutex);
+      m_iEPGFailures         = 0;
+      m_iEPGNextAttempt      = 0;
+      m_iEPGCircuitOpenUntil = 0;
+      continue;
+    }
+
+    CLockObject lock(m_mutex);
+    ScheduleEPGRetry();
+  }
+
+  return NULL;
+}
+
+void PVRIptvData::UpdateFileWatches(void)
+{
+  CLockObject lock(m_mutex);
+  std::vector<std::string> playlists = GetPlayListSources();
+  std::vector<std::string> guides    = m_xmltvSources;
+  m_bWatchesChanged = false;
+  lock.Unlock();
+
+  m_watcher.Clear();
+
+  std::vector<std::string>::iterator it;
+  for (it = playlists.begin(); it != playlists.end(); ++it)
+  {
+    if (PVRIptvFileWatcher::CanWatch(*it))
+      m_watcher.Add(*it, FILE_WATCH_PLAYLIST);
+  }
+  for (size_t iSource = 0; iSource < guides.size(); iSource++)
+  {
+    // per channel guides are not watched, there may be thousands of them
+    if (!IsEPGTemplate(guides[iSource]) && PVRIptvFileWatcher::CanWatch(guides[iSource]))
+      m_watcher.Add(guides[iSource], FILE_WATCH_EPG + iSource);
+  }
+
+  // the one shipped with the addon never changes
+  m_watcher.Add(GetUserFilePath(GENRES_MAP_FILENAME), FILE_WATCH_GENRES);
+}
+
+void PVRIptvData::CheckWatchedFiles(void)
+{
+  CLockObject lock(m_mutex);
+  bool bWatchesChanged = m_bWatchesChanged;
+  lock.Unlock();
+  if (bWatchesChanged)
+    UpdateFileWatches();
+
+  std::vector<int> tags;
+  if (!m_watcher.Poll(tags))
+    return;
+
+  bool bPlaylist = false;
+  bool bGenres   = false;
+  lock.Lock();
+  std::vector<int>::iterator it;
+  for (it = tags.begin(); it != tags.end(); ++it)
+  {
+    if (*it == FILE_WATCH_PLAYLIST)
+      bPlaylist = true;
+    else if (*it == FILE_WATCH_GENRES)
+      bGenres = true;
+    else if ((size_t)(*it - FILE_WATCH_EPG) < m_epgSourcePending.size())
+    {
+      // only the changed guide is loaded again
+      XBMC->Log(LOG_NOTICE, "EPG file '%s' has changed.", m_xmltvSources[*it - FILE_WATCH_EPG].c_str());
+      m_epgSourcePending[*it - FILE_WATCH_EPG] = true;
+      m_bEPGLoadRequested = true;
+    }
+  }
+  lock.Unlock();
+
+  // genres are looked up when the guide is sent to Kodi, nothing else to reload
+  if (bGenres)
+  {
+    XBMC->Log(LOG_NOTICE, "Genres file has changed.");
+    LoadGenres();
+  }
+
+  if (bPlaylist)
+  {
+    XBMC->Log(LOG_NOTICE, "Playlist file has changed.");
+    RefreshPlayList();
+  }
+}
+
+void PVRIptvData::ScheduleEPGRetry(void)
+{
+  // must be called with m_mutex held
+  // keep the request pending, the last good EPG is served meanwhile
+  m_bEPGLoadRequested = true;
+
+  if (++m_iEPGFailures >= EPG_CIRCUIT_BREAKER_FAILURES)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load EPG after %d tries, next try in %d seconds.",
+              m_iEPGFailures, EPG_CIRCUIT_BREAKER_COOLDOWN);
+    m_iEPGFailures         = 0;
+    m_iEPGNextAttempt      = 0;
+    m_iEPGCircuitOpenUntil = time(NULL) + EPG_CIRCUIT_BREAKER_COOLDOWN;
+  }
+  else
+  {
+    // exponential backoff with up to 50% random jitter
+    uint64_t iDelay = std::min<uint64_t>((uint64_t)EPG_RETRY_BASE_DELAY_MS << (m_iEPGFailures - 1),
+                                         EPG_RETRY_MAX_DELAY_MS);
+    iDelay += rand() % (iDelay / 2 + 1);
+    m_iEPGNextAttempt = GetTimeMs() + iDelay;
+  }
+}
+
+PVRIptvData::~PVRIptvData(void)
+{
+  StopThread(0);
+  m_epgLoadEvent.Signal();
+  m_resumeEvent.Broadcast();
+  m_playlistEvent.Broadcast();
+  StopThread();
+
+  // waits for running cache refreshes, they give up once the thread is stopped
+  delete m_refreshPool;
+  m_refreshPool = NULL;
+  // pending cache writes are finished, they are still valid
+  delete m_cacheWritePool;
+  m_cacheWritePool = NULL;
+
+  // nothing is left to hand their contents over
+  std::unordered_map<std::string, PVRIptvCacheWriteJob*>::iterator write;
+  for (write = m_waitingWrites.begin(); write != m_waitingWrites.end(); ++write)
+    delete write->second;
+  m_waitingWrites.clear();
+
+  m_channels.clear();
+  m_groups.clear();
+  m_groupIndex.clear();
+  m_channelIndex.clear();
+  m_epg.clear();
+  m_genres.clear();
+}
+
+bool PVRIptvData::LoadEPG(time_t iStart, time_t iEnd)
+{
+  CLockObject lock(m_mutex);
+  std::vector<std::string> sources = m_xmltvSources;
+  std::vector<bool>        pending = m_epgSourcePending;
+  lock.Unlock();
+
+  if (sources.empty())
+  {
+    XBMC->Log(LOG_NOTICE, "EPG file path is not configured. EPG not loaded.");
+    return true;
+  }
+
+  // later changes are picked up by the file watches
+  lock.Lock();
+  bool bLoadGenres = !m_bGenresLoaded;
+  m_bGenresLoaded = true;
+  lock.Unlock();
+  if (bLoadGenres)
+    LoadGenres();
+
+  // every source on its own worker, each one is published as soon as it is ready
+  std::vector<PVRIptvEpgSourceJob*> jobs;
+  PVRIptvJobPool pool(sources.size());
+  for (size_t iSource = 0; iSource < sources.size(); iSource++)
+  {
+    if (!pending[iSource])
+      continue;
+
+    PVRIptvEpgSourceJob *job = new PVRIptvEpgSourceJob(*this, iSource, sources[iSource], iStart, iEnd);
+    jobs.push_back(job);
+    pool.Add(job);
+  }
+  pool.Wait();
+
+  TriggerEpgUpdates();
+
+  // only failed sources are tried again
+  bool bResult = true;
+  lock.Lock();
+  std::vector<PVRIptvEpgSourceJob*>::iterator it;
+  for (it = jobs.begin(); it != jobs.end(); ++it)
+  {
+    if ((*it)->m_bResult && (*it)->m_iSource < m_epgSourcePending.size())
+      m_epgSourcePending[(*it)->m_iSource] = false;
+    bResult &= (*it)->m_bResult;
+    delete *it;
+  }
+
+  return bResult;
+}
+
+bool PVRIptvData::LoadEPGSource(size_t iSource, const std::string &strXMLTVUrl, time_t iStart, time_t iEnd)
+{
+  if (IsEPGTemplate(strXMLTVUrl))
+    return LoadEPGChannels(iSource, strXMLTVUrl, iStart, iEnd);
+
+  std::string strCachedName = GetEPGCacheName(strXMLTVUrl);
+  std::string strData;
+  uint64_t iHash;
+  if (!FetchEPG(strCachedName, strXMLTVUrl, strData, iHash))
+    return false;
+
+  // channel matching needs the playlist
+  WaitForPlaylist();
+  if (IsStopped())
+  {
+    ReleaseCachedFile(strCachedName, strData);
+    return false;
+  }
+
+  // the same guide for the same interval and channels is already published
+  CLockObject lock(m_mutex);
+  std::string strKey = StringUtils::Format("%016llx|%lld|%lld|%u", (unsigned long long)iHash,
+    (long long)iStart, (long long)iEnd, m_iChannelsGeneration);
+  uint64_t iKey = HashString64(strKey.c_str(), strKey.size());
+  if (iSource < m_epgSourceKeys.size() && m_epgSourceKeys[iSource] == iKey)
+  {
+    XBMC->Log(LOG_NOTICE, "EPG from '%s' is unchanged.", strXMLTVUrl.c_str());
+    lock.Unlock();
+    ReleaseCachedFile(strCachedName, strData);
+    return true;
+  }
+  lock.Unlock();
+
+  std::string strXml;
+  if (!UnpackEPG(strCachedName, strXMLTVUrl, strData, strXml))
+    return false;
+
+  std::vector<PVRIptvEpgChannel> epgChannels;
+  if (!ParseEPG(strXml, iStart, iEnd, epgChannels))
+    return false;
+
+  PublishEPG(iSource, epgChannels);
+
+  lock.Lock();
+  if (iSource < m_epgSourceKeys.size())
+    m_epgSourceKeys[iSource] = iKey;
+  lock.Unlock();
+
+  XBMC->Log(LOG_NOTICE, "EPG Loaded from '%s'.", strXMLTVUrl.c_str());
+  return true;
+}
+
+bool PVRIptvData::LoadEPGChannels(size_t iSource, const std::string &strTemplate, time_t iStart, time_t iEnd)
+{
+  // only guides of the channels we carry are fetched
+  WaitForPlaylist();
+  if (IsStopped())
+    return false;
+
+  CLockObject lock(m_mutex);
+  std::set<std::string> tvgIds;
+  std::vector<PVRIptvChannel>::iterator channel;
+  for (channel = m_channels.begin(); channel != m_channels.end(); ++channel)
+  {
+    if (channel->bHasTvgId)
+      tvgIds.insert(channel->strTvgId);
+  }
+  unsigned int iGeneration = m_iChannelsGeneration;
+  lock.Unlock();
+
+  if (tvgIds.empty())
+  {
+    XBMC->Log(LOG_NOTICE, "No channel with tvg-id for EPG template '%s'.", strTemplate.c_str());
+    return true;
+  }
+
+  std::vector<PVRIptvEpgChannelJob*> jobs;
+  PVRIptvJobPool pool(std::min<size_t>(tvgIds.size(), EPG_CHANNEL_MAX_WORKERS));
+  std::set<std::string>::iterator it;
+  for (it = tvgIds.begin(); it != tvgIds.end(); ++it)
+  {
+    PVRIptvEpgChannelJob *job = new PVRIptvEpgChannelJob(*this, GetEPGChannelCacheName(strTemplate, *it),
+                                                         GetEPGChannelUrl(strTemplate, *it));
+    jobs.push_back(job);
+    pool.Add(job);
+  }
+  pool.Wait();
+
+  // expired copies are served now and replaced together, so that a single
+  // reload picks up all changed files
+  std::vector<std::string> expiredNames, expiredPaths;
+  std::set<std::string> cachedNames;
+  std::vector<PVRIptvEpgChannelJob*>::iterator job;
+  for (job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    cachedNames.insert((*job)->m_strCachedName);
+    if (!(*job)->m_bExpired)
+      continue;
+    expiredNames.push_back((*job)->m_strCachedName);
+    expiredPaths.push_back((*job)->m_strXMLTVUrl);
+  }
+
+  std::string strBatchName = GetEPGCacheName(strTemplate);
+  if (!expiredNames.empty())
+  {
+    lock.Lock();
+    if (m_refreshing.insert(strBatchName).second)
+    {
+      XBMC->Log(LOG_DEBUG, "%u cached EPG files of '%s' expired, refreshing them in background.",
+                (unsigned int)expiredNames.size(), strTemplate.c_str());
+      m_refreshPool->Add(new PVRIptvCacheBatchRefreshJob(*this, strBatchName, expiredNames, expiredPaths));
+    }
+    lock.Unlock();
+  }
+
+  // guides of channels that left the playlist are not kept
+  std::string strPrefix = GetCacheName(TVG_FILE_PREFIX, strTemplate, ".");
+  std::vector<std::string> files = GetUserFiles(strPrefix);
+  std::vector<std::string>::iterator file;
+  for (file = files.begin(); file != files.end(); ++file)
+  {
+    // side files share the name of their cache
+    size_t iEnd = file->find(".xml.cache");
+    if (iEnd == std::string::npos || cachedNames.find(file->substr(0, iEnd + 10)) == cachedNames.end())
+      DeleteUserFile(*file);
+  }
+
+  // the same guides for the same interval and channels are already published
+  std::string strKey = StringUtils::Format("%lld|%lld|%u", (long long)iStart, (long long)iEnd, iGeneration);
+  size_t iLoaded = 0;
+  for (job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    if (!(*job)->m_bResult)
+    {
+      strKey += "|-";
+      continue;
+    }
+    strKey += StringUtils::Format("|%016llx", (unsigned long long)(*job)->m_iHash);
+    iLoaded++;
+  }
+  uint64_t iKey = HashString64(strKey.c_str(), strKey.size());
+
+  lock.Lock();
+  bool bUnchanged = iSource < m_epgSourceKeys.size() && m_epgSourceKeys[iSource] == iKey;
+  lock.Unlock();
+
+  // a channel without guide is no failure, a template without any is
+  std::vector<PVRIptvEpgChannel> epgChannels;
+  std::set<std::string> epgIds;
+  for (job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    if ((*job)->m_bResult && !bUnchanged && !IsStopped())
+    {
+      std::string strXml;
+      std::vector<PVRIptvEpgChannel> fileChannels;
+      if (UnpackEPG((*job)->m_strCachedName, (*job)->m_strXMLTVUrl, (*job)->m_strData, strXml)
+        && ParseEPG(strXml, iStart, iEnd, fileChannels))
+      {
+        // a channel found in several files is taken from the first one
+        std::vector<PVRIptvEpgChannel>::iterator epg;
+        for (epg = fileChannels.begin(); epg != fileChannels.end(); ++epg)
+        {
+          std::string strId = epg->strId;
+          StringUtils::ToLower(strId);
+          if (!epgIds.insert(strId).second)
+            continue;
+          epgChannels.push_back(PVRIptvEpgChannel());
+          std::swap(epgChannels.back(), *epg);
+        }
+      }
+    }
+    delete *job;
+  }
+
+  if (iLoaded == 0)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load any EPG file from template '%s'.", strTemplate.c_str());
+    return false;
+  }
+  if (bUnchanged)
+  {
+    XBMC->Log(LOG_NOTICE, "EPG from '%s' is unchanged.", strTemplate.c_str());
+    return true;
+  }
+  if (IsStopped())
+    return false;
+
+  // each file numbered its programmes from one
+  int iBroadcastId = 0;
+  std::vector<PVRIptvEpgChannel>::iterator epg;
+  for (epg = epgChannels.begin(); epg != epgChannels.end(); ++epg)
+  {
+    std::vector<PVRIptvEpgEntry>::iterator entry;
+    for (entry = epg->epg.begin(); entry != epg->epg.end(); ++entry)
+      entry->iBroadcastId = ++iBroadcastId;
+  }
+
+  PublishEPG(iSource, epgChannels);
+
+  lock.Lock();
+  if (iSource < m_epgSourceKeys.size())
+    m_epgSourceKeys[iSource] = iKey;
+  lock.Unlock();
+
+  XBMC->Log(LOG_NOTICE, "EPG Loaded for %u of %u channels from '%s'.", (unsigned int)iLoaded,
+            (unsigned int)tvgIds.size(), strTemplate.c_str());
+  return true;
+}
+
+bool PVRIptvData::FetchEPG(const std::string &strCachedName, const std::string &strXMLTVUrl, std::string &data,
+                           uint64_t &iHash, bool *pExpired /* NULL */)
+{
+  // retries are scheduled by the background loader, see Process()
+  if (GetCachedFileContents(strCachedName, strXMLTVUrl, data, g_bCacheEPG, IPTV_CACHE_EPG, &iHash, NULL,
+                            pExpired) == 0)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load EPG file '%s':  file is missing or empty.", strXMLTVUrl.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool PVRIptvData::UnpackEPG(const std::string &strCachedName, const std::string &strXMLTVUrl, std::string &data,
+                            std::string &strXml)
+{
+  // a packed guide is unpacked from where it is and then handed to the cache
+  // write waiting for it, a plain one is parsed in place, the write gets a copy
+  int iLayer = 0;
+  if (PVRIptvDecompressor::IsCompressed(data.c_str(), data.size()))
+  {
+    bool bResult = PVRIptvDecompressor::Decompress(data.c_str(), data.size(), strXml);
+    ReleaseCachedFile(strCachedName, data);
+    std::string().swap(data);
+    if (!bResult)
+    {
+      XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': unable to decompress file.", strXMLTVUrl.c_str());
+      return false;
+    }
+    iLayer++;
+  }
+  else
+  {
+    strXml.swap(data);
+    ReleaseCachedFile(strCachedName, strXml, true);
+  }
+
+  // archives may hold a packed guide, the format of each layer is told by its content
+  for (; iLayer < EPG_UNPACK_MAX_LAYERS; iLayer++)
+  {
+    const char *pData   = strXml.c_str();
+    size_t      iLength = strXml.size();
+
+    if (PVRIptvDecompressor::IsCompressed(pData, iLength))
+    {
+      if (!PVRIptvDecompressor::Decompress(pData, iLength, data))
+      {
+        XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': unable to decompress file.", strXMLTVUrl.c_str());
+        return false;
+      }
+      strXml.swap(data);
+      std::string().swap(data);
+    }
+    else if (PVRIptvTarReader::IsTar(pData, iLength))
+    {
+      size_t iOffset, iSize;
+      std::string strName;
+      if (!PVRIptvTarReader::FindMember(pData, iLength, iOffset, iSize, strName))
+      {
+        XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': no file found in archive.", strXMLTVUrl.c_str());
+        return false;
+      }
+      XBMC->Log(LOG_DEBUG, "Using '%s' of EPG archive '%s'.", strName.c_str(), strXMLTVUrl.c_str());
+      strXml.erase(iOffset + iSize);
+      strXml.erase(0, iOffset);
+    }
+    else
+      break;
+  }
+
+  // xml should start with '<', possibly after a BOM
+  size_t iStart = strXml.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+  iStart = strXml.find_first_not_of(" \t\r\n", iStart);
+  if (iStart == std::string::npos || strXml[iStart] != '<')
+  {
+    XBMC->Log(LOG_ERROR, "Invalid EPG file '%s': unable to parse file.", strXMLTVUrl.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool PVRIptvData::ParseEPG(std::string &strXml, time_t iStart, time_t iEnd, std::vector<PVRIptvEpgChannel> &epgChannels)
+{
+  xml_document<> xmlDoc;
+  try
+  {
+    xmlDoc.parse<0>(&strXml[0]);
+  }
+  catch(parse_error p)
+  {
+    XBMC->Log(LOG_ERROR, "Unable parse EPG XML: %s", p.what());
+    return false;
+  }
+
+  xml_node<> *pRootElement = xmlDoc.first_node("tv");
+  if (!pRootElement)
+  {
+    XBMC->Log(LOG_ERROR, "Invalid EPG XML: no <tv> tag found");
+    return false;
+  }
+
+  // build the new epg aside, the previous one stays available until it is replaced,
+  // channels are matched against a copy so m_mutex is not held while matching
+  CLockObject lock(m_mutex);
+  std::vector<PVRIptvChannel> channels = m_channels;
+  int iEPGTimeShift = m_iEPGTimeShift;
+  bool bTSOverride = m_bTSOverride;
+  lock.Unlock();
+
+  int iBroadCastId = 0;
+  xml_node<> *pChannelNode = NULL;
+  for(pChannelNode = pRootElement->first_node("channel"); pChannelNode; pChannelNode = pChannelNode->next_sibling("channel"))
+  {
+    std::string strName;
+    std::string strId;
+    if(!GetAttributeValue(pChannelNode, "id", strId))
+      continue;
+
+    GetNodeValue(pChannelNode, "display-name", strName);
+    if (FindChannel(channels, strId, strName) == NULL)
+      continue;
+
+    PVRIptvEpgChannel epgChannel;
+    epgChannel.strId = strId;
+    epgChannel.strName = strName;
+
+    // get icon if available
+    xml_node<> *pIconNode = pChannelNode->first_node("icon");
+    if (pIconNode == NULL || !GetAttributeValue(pIconNode, "src", epgChannel.strIcon))
+      epgChannel.strIcon = "";
+
+    epgChannels.push_back(epgChannel);
+  }
+
+  if (epgChannels.size() == 0)
+  {
+    XBMC->Log(LOG_ERROR, "EPG channels not found.");
+    return false;
+  }
+
+  int iMinShiftTime = iEPGTimeShift;
+  int iMaxShiftTime = iEPGTimeShift;
+  if (!bTSOverride)
+  {
+    iMinShiftTime = SECONDS_IN_DAY;
+    iMaxShiftTime = -SECONDS_IN_DAY;
+
+    std::vector<PVRIptvChannel>::iterator it;
+    for (it = channels.begin(); it < channels.end(); ++it)
+    {
+      if (it->iTvgShift + iEPGTimeShift < iMinShiftTime)
+        iMinShiftTime = it->iTvgShift + iEPGTimeShift;
+      if (it->iTvgShift + iEPGTimeShift > iMaxShiftTime)
+        iMaxShiftTime = it->iTvgShift + iEPGTimeShift;
+    }
+  }
+
+  uint64_t iSliceStart = GetTimeMs();
+  PVRIptvEpgChannel *epg = NULL;
+  for(pChannelNode = pRootElement->first_node("programme"); pChannelNode; pChannelNode = pChannelNode->next_sibling("programme"))
+  {
+    if (!YieldBackgroundWork(iSliceStart))
+      return false;
+
+    std::string strId;
+    if (!GetAttributeValue(pChannelNode, "channel", strId))
+      continue;
+
+    if (NULL == epg || StringUtils::CompareNoCase(epg->strId, strId) != 0)
+    {
+      if ((epg = FindEpg(epgChannels, strId)) == NULL)
+        continue;
+    }
+
+    std::string strStart, strStop;
+    if ( !GetAttributeValue(pChannelNode, "start", strStart)
+      || !GetAttributeValue(pChannelNode, "stop", strStop))
+      continue;
+
+    int iTmpStart = ParseDateTime(strStart);
+    int iTmpEnd = ParseDateTime(strStop);
+
+    if ( (iTmpEnd   + iMaxShiftTime < iStart)
+      || (iTmpStart + iMinShiftTime > iEnd))
+      continue;
+
+    PVRIptvEpgEntry entry;
+    entry.iBroadcastId = ++iBroadCastId;
+    entry.iGenreType = 0;
+    entry.iGenreSubType = 0;
+    entry.strPlotOutline = "";
+    entry.startTime = iTmpStart;
+    entry.endTime = iTmpEnd;
+
+    GetNodeValue(pChannelNode, "title", entry.strTitle);
+    GetNodeValue(pChannelNode, "desc", entry.strPlot);
+    GetNodeValue(pChannelNode, "category", entry.strGenreString);
+
+    xml_node<> *pIconNode = pChannelNode->first_node("icon");
+    if (pIconNode == NULL || !GetAttributeValue(pIconNode, "src", entry.strIconPath))
+      entry.strIconPath = "";
+
+    epg->epg.push_back(entry);
+  }
+
+  xmlDoc.clear();
+  return true;
+}
+
+void PVRIptvData::PublishEPG(size_t iSource, std::vector<PVRIptvEpgChannel> &epgChannels)
+{
+  CLockObject mergeLock(m_epgMergeMutex);
+
+  if (m_epgSources.size() > 1)
+  {
+    // keep every source, a failed one is merged with its last good data
+    if (iSource >= m_epgSources.size())
+      return;
+
+    m_epgSources[iSource].swap(epgChannels);
+    epgChannels.clear();
+    MergeEPGSources(epgChannels);
+  }
+
+  CLockObject lock(m_mutex);
+  std::vector<PVRIptvChannel> channels = m_channels;
+  lock.Unlock();
+
+  // remember the channels whose programmes changed, LoadEPG() triggers them once all sources are in
+  std::unordered_map<int, uint64_t> epgHashes;
+  std::vector<PVRIptvChannel>::iterator channel;
+  for (channel = channels.begin(); channel != channels.end(); ++channel)
+  {
+    uint64_t iHash = HashEpgChannel(FindEpgForChannel(epgChannels, *channel));
+    std::unordered_map<int, uint64_t>::const_iterator it = m_epgChannelHashes.find(channel->iUniqueId);
+    if (it == m_epgChannelHashes.end() || it->second != iHash)
+      m_epgChangedChannels.insert(channel->iUniqueId);
+    epgHashes[channel->iUniqueId] = iHash;
+  }
+  m_epgChannelHashes.swap(epgHashes);
+
+  lock.Lock();
+  m_epg.swap(epgChannels);
+  lock.Unlock();
+  mergeLock.Unlock();
+
+  if (g_iEPGLogos > 0)
+    ApplyChannelsLogosFromEPG();
+}
+
+void PVRIptvData::MergeEPGSources(std::vector<PVRIptvEpgChannel> &merged)
+{
+  // must be called with m_epgMergeMutex held
+  // sources are in priority order, programmes of a lower priority source
+  // are only taken where no higher priority source has one
+  std::map<std::string, size_t> channelIndex;
+
+  std::vector<std::vector<PVRIptvEpgChannel> >::iterator source;
+  for (source = m_epgSources.begin(); source != m_epgSources.end(); ++source)
+  {
+    std::vector<PVRIptvEpgChannel>::iterator channel;
+    for (channel = source->begin(); channel != source->end(); ++channel)
+    {
+      std::string strKey = channel->strId;
+      StringUtils::ToLower(strKey);
+
+      std::map<std::string, size_t>::iterator it = channelIndex.find(strKey);
+      if (it == channelIndex.end())
+      {
+        channelIndex[strKey] = merged.size();
+        merged.push_back(*channel);
+        std::sort(merged.back().epg.begin(), merged.back().epg.end(), EpgEntryStartsBefore);
+        continue;
+      }
+
+      PVRIptvEpgChannel &target = merged.at(it->second);
+      if (target.strIcon.empty())
+        target.strIcon = channel->strIcon;
+
+      size_t iKept = target.epg.size();
+      std::vector<PVRIptvEpgEntry>::iterator entry;
+      for (entry = channel->epg.begin(); entry != channel->epg.end(); ++entry)
+      {
+        if (!EpgEntryOverlaps(target.epg, iKept, *entry))
+          target.epg.push_back(*entry);
+      }
+      std::sort(target.epg.begin(), target.epg.end(), EpgEntryStartsBefore);
+    }
+  }
+
+  // broadcast ids must stay unique over all sources
+  int iBroadcastId = 0;
+  std::vector<PVRIptvEpgChannel>::iterator channel;
+  for (channel = merged.begin(); channel != merged.end(); ++channel)
+  {
+    std::vector<PVRIptvEpgEntry>::iterator entry;
+    for (entry = channel->epg.begin(); entry != channel->epg.end(); ++entry)
+      entry->iBroadcastId = ++iBroadcastId;
+  }
+}
+
+void PVRIptvData::SetEPGSources(void)
+{
+  // same lock order as PublishEPG()
+  CLockObject mergeLock(m_epgMergeMutex);
+  CLockObject lock(m_mutex);
+
+  // primary source first
+  m_xmltvSources.clear();
+  if (!m_strXMLTVUrl.empty())
+    m_xmltvSources.push_back(m_strXMLTVUrl);
+
+  std::vector<std::string> extraSources = StringUtils::Split(g_strTvgExtraPaths, EPG_SOURCES_SEPARATOR);
+  std::vector<std::string>::iterator it;
+  for (it = extraSources.begin(); it != extraSources.end(); ++it)
+  {
+    std::string strSource = *it;
+    StringUtils::Trim(strSource);
+    if (!strSource.empty())
+      m_xmltvSources.push_back(strSource);
+  }
+
+  m_epgSources.clear();
+  m_epgSources.resize(m_xmltvSources.size());
+  m_epgSourcePending.assign(m_xmltvSources.size(), true);
+  m_epgSourceKeys.assign(m_xmltvSources.size(), 0);
+  m_bWatchesChanged = true;
+}
+
+std::vector<std::string> PVRIptvData::GetPlayListSources(void)
+{
+  // must be called with m_mutex held
+  std::vector<std::string> sources;
+  if (!m_strM3uUrl.empty())
+    sources.push_back(m_strM3uUrl);
+
+  std::vector<std::string> extraSources = StringUtils::Split(g_strM3UExtraPaths, M3U_SOURCES_SEPARATOR);
+  std::vector<std::string>::iterator it;
+  for (it = extraSources.begin(); it != extraSources.end(); ++it)
+  {
+    std::string strSource = *it;
+    StringUtils::Trim(strSource);
+    if (!strSource.empty())
+      sources.push_back(strSource);
+  }
+
+  return sources;
+}
+
+class PVRIptvPlaylistFetchJob : public PVRIptvJob
+{
+public:
+  PVRIptvPlaylistFetchJob(PVRIptvData &data, const std::string &strCachedName, const std::string &strM3uUrl)
+    : m_data(data), m_strCachedName(strCachedName), m_strM3uUrl(strM3uUrl), m_iLength(0), m_iContentHash(0) {}
+
+  // deleted once the playlist is parsed, the download goes to its cache
+  virtual ~PVRIptvPlaylistFetchJob(void) { m_data.ReleaseCachedFile(m_strCachedName, m_strContent); }
+
+  virtual void Run(void)
+  {
+    if (PVRIptvXtream::IsXtreamUrl(m_strM3uUrl))
+      m_iLength = m_data.LoadXtreamPlayList(m_strCachedName, m_strM3uUrl, m_strContent, m_iContentHash);
+    else
+      m_iLength = m_data.GetCachedFileContents(m_strCachedName, m_strM3uUrl, m_strContent, g_bCacheM3U,
+                                               IPTV_CACHE_PLAYLIST, &m_iContentHash, &m_file);
+  }
+
+  // caches are parsed straight from the mapping
+  const char *Data(void) const { return m_file.IsOpen() ? m_file.Data() : m_strContent.c_str(); }
+
+  PVRIptvData       &m_data;
+  std::string        m_strCachedName;
+  std::string        m_strM3uUrl;
+  std::string        m_strContent;
+  PVRIptvMappedFile  m_file;
+  size_t             m_iLength;
+  uint64_t           m_iContentHash;
+};
+
+bool PVRIptvData::LoadPlayList(bool &bChannelsChanged, bool &bGroupsChanged)
+{
+  bChannelsChanged = false;
+  bGroupsChanged   = false;
+
+  // a background cache refresh may reload while another load runs, the
+  // later one must also be the one that gets swapped in last
+  CLockObject loadLock(m_playlistLoadMutex);
+
+  CLockObject lock(m_mutex);
+  std::vector<std::string> sources = GetPlayListSources();
+  std::string strLogoPath = m_strLogoPath;
+  lock.Unlock();
+
+  if (sources.empty())
+  {
+    XBMC->Log(LOG_NOTICE, "Playlist file path is not configured. Channels not loaded.");
+    return false;
+  }
+
+  // download all playlists at once
+  std::vector<PVRIptvPlaylistFetchJob*> jobs;
+  PVRIptvJobPool pool(sources.size());
+  for (size_t iSource = 0; iSource < sources.size(); iSource++)
+  {
+    std::string strCachedName = GetCacheName(M3U_FILE_PREFIX, sources[iSource], ".m3u.cache");
+
+    PVRIptvPlaylistFetchJob *job = new PVRIptvPlaylistFetchJob(*this, strCachedName, sources[iSource]);
+    jobs.push_back(job);
+    pool.Add(job);
+  }
+  pool.Wait();
+
+  // build the new channel list aside, Kodi keeps reading the current one
+  std::vector<PVRIptvChannel>      channels;
+  std::vector<PVRIptvChannelGroup> groups;
+  PVRIptvGroupIndex                groupIndex;
+  std::set<uint64_t>               streamHashes;
+  std::set<uint64_t>               tvgIdHashes;
+  bool                             bResult = true;
+  bool                             bLoaded = false;
+
+  // the snapshot is only valid for the same playlists and settings
+  std::string strSnapshotKey = StringUtils::Format("%d|%d|%d|%s|%s|%s", g_iStartNumber, g_iM3UNumberOffset,
+    g_iChannelIdMode, g_strM3UIncludeFilter.c_str(), g_strM3UExcludeFilter.c_str(), strLogoPath.c_str());
+  for (size_t iSource = 0; iSource < jobs.size(); iSource++)
+  {
+    PVRIptvPlaylistFetchJob *job = jobs[iSource];
+    strSnapshotKey += StringUtils::Format("|%s|%016llx", job->m_strM3uUrl.c_str(),
+      (unsigned long long)(job->m_iLength == 0 ? 0 : job->m_iContentHash));
+    bLoaded = bLoaded || job->m_iLength > 0;
+  }
+  uint64_t iSnapshotKey = HashString64(strSnapshotKey.c_str(), strSnapshotKey.size());
+
+  // same playlists as the ones loaded, nothing to parse
+  lock.Lock();
+  if (bLoaded && iSnapshotKey == m_iPlaylistKey)
+  {
+    XBMC->Log(LOG_NOTICE, "Playlists are unchanged, keeping %u channels.", (unsigned int)m_channels.size());
+    lock.Unlock();
+    for (size_t iSource = 0; iSource < jobs.size(); iSource++)
+      delete jobs[iSource];
+    return true;
+  }
+  lock.Unlock();
+
+  std::string strSnapshotPath = GetUserFilePath(CHANNELS_SNAPSHOT_NAME);
+  std::string strSnapshot;
+  bool bFromSnapshot = bLoaded && XBMC->FileExists(strSnapshotPath.c_str(), false)
+    && GetFileContents(strSnapshotPath, strSnapshot) > 0
+    && PVRIptvSnapshot::Read(strSnapshot, iSnapshotKey, channels, groups);
+  strSnapshot.clear();
+
+  if (bFromSnapshot)
+  {
+    XBMC->Log(LOG_DEBUG, "Channels restored from snapshot.");
+    for (size_t iGroup = 0; iGroup < groups.size(); iGroup++)
+      groupIndex[groups[iGroup].strGroupName] = iGroup;
+  }
+  else
+  {
+    channels.clear();
+    groups.clear();
+  }
+
+  // playlists are parsed in order, each one numbered from its own offset,
+  // a missing one is skipped
+  for (size_t iSource = 0; iSource < jobs.size(); iSource++)
+  {
+    PVRIptvPlaylistFetchJob *job = jobs[iSource];
+    if (!bFromSnapshot && bResult)
+    {
+      if (job->m_iLength == 0)
+        XBMC->Log(LOG_ERROR, "Unable to load playlist file '%s':  file is missing or empty.", job->m_strM3uUrl.c_str());
+      else
+        bResult = ParsePlayList(job->m_strM3uUrl, job->Data(), job->m_iLength, g_iStartNumber + iSource * g_iM3UNumberOffset,
+                                channels, groups, groupIndex, streamHashes, tvgIdHashes);
+    }
+    delete job;
+  }
+
+  if (!bResult || !bLoaded)
+    return false;
+
+  if (channels.size() == 0)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load channels from file '%s':  file is corrupted.", sources[0].c_str());
+    return false;
   }
 
-  xml_document<> xmlDoc;
-  try
+  // colliding ids are probed in playlist order, so they stay the same between loads
+  PVRIptvChannelIndex channelIndex;
+  for (unsigned int iChannel = 0; iChannel < channels.size(); iChannel++)
   {
-    xmlDoc.parse<0>(buffer);
+    PVRIptvChannel &channel = channels[iChannel];
+    while (!channelIndex.insert(PVRIptvChannelIndex::value_type(channel.iUniqueId, iChannel)).second)
+    {
+      XBMC->Log(LOG_DEBUG, "Channel id %d of '%s' is already used.", channel.iUniqueId, channel.strChannelName.c_str());
+      channel.iUniqueId = NextChannelId(channel.iUniqueId);
+    }
   }
-  catch(parse_error p)
+
+  if (!bFromSnapshot)
   {
-    XBMC->Log(LOG_ERROR, "Unable parse EPG XML: %s", p.what());
-    return false;
+    ApplyChannelsLogos(channels, strLogoPath);
+
+    PVRIptvSnapshot::Write(iSnapshotKey, channels, groups, strSnapshot);
+    m_cacheWritePool->Add(new PVRIptvSnapshotWriteJob(strSnapshotPath, strSnapshot));
   }
 
-  xml_node<> *pRootElement = xmlDoc.first_node("tv");
-  if (!pRootElement)
+  // Kodi is only told about real changes, a refresh without any costs nothing
+  lock.Lock();
+  bChannelsChanged = ChannelsDiffer(m_channels, m_channelIndex, channels);
+  bGroupsChanged   = GroupsDiffer(m_groups, m_channels, groups, channels);
+  m_iPlaylistKey = iSnapshotKey;
+  if (!bChannelsChanged && !bGroupsChanged)
   {
-    XBMC->Log(LOG_ERROR, "Invalid EPG XML: no <tv> tag found");
-    return false;
+    XBMC->Log(LOG_NOTICE, "Loaded %u channels, no changes.", (unsigned int)m_channels.size());
+    return true;
   }
 
-  // clear previously loaded epg
-  if (m_epg.size() > 0)
-    m_epg.clear();
+  m_iChannelsGeneration++;
+  m_channels.swap(channels);
+  m_channelIndex.swap(channelIndex);
+  m_groups.swap(groups);
+  m_groupIndex.swap(groupIndex);
+  if (m_strLogoPath != strLogoPath)
+    ApplyChannelsLogos(m_channels, m_strLogoPath);
+  if (g_iEPGLogos > 0)
+    UpdateChannelsLogosFromEPG();
 
-  int iBroadCastId = 0;
-  xml_node<> *pChannelNode = NULL;
-  for(pChannelNode = pRootElement->first_node("channel"); pChannelNode; pChannelNode = pChannelNode->next_sibling("channel"))
-  {
-    std::string strName;
-    std::string strId;
-    if(!GetAttributeValue(pChannelNode, "id", strId))
-      continue;
+  // guides were matched against the previous channels, the initial load
+  // waits for the playlist before matching
+  if (bChannelsChanged && m_bPlaylistLoaded)
+    RequestEPGLoad(m_iLastStart, m_iLastEnd);
 
-    GetNodeValue(pChannelNode, "display-name", strName);
-    if (FindChannel(strId, strName) == NULL)
-      continue;
+  XBMC->Log(LOG_NOTICE, "Loaded %u channels.", (unsigned int)m_channels.size());
+  return true;
+}
 
-    PVRIptvEpgChannel epgChannel;
-    epgChannel.strId = strId;
-    epgChannel.strName = strName;
+/*
+ * Cache files of an API playlist source are named after its playlist cache
+ */
+static std::string GetXtreamCacheName(const std::string &strCachedName, const std::string &strPart)
+{
+  return strCachedName.substr(0, strCachedName.rfind(".cache")) + "." + strPart + ".cache";
+}
 
-    // get icon if available
-    xml_node<> *pIconNode = pChannelNode->first_node("icon");
-    if (pIconNode == NULL || !GetAttributeValue(pIconNode, "src", epgChannel.strIcon))
-      epgChannel.strIcon = "";
+class PVRIptvXtreamCategoryJob : public PVRIptvJob
+{
+public:
+  PVRIptvXtreamCategoryJob(PVRIptvData &data, const std::string &strCachedName, const std::string &strUrl,
+                           const std::string &strGroup)
+    : m_data(data), m_strCachedName(strCachedName), m_strUrl(strUrl), m_strGroup(strGroup), m_iLength(0) {}
 
-    m_epg.push_back(epgChannel);
-  }
+  // deleted once the streams are appended, the download goes to its cache
+  virtual ~PVRIptvXtreamCategoryJob(void) { m_data.ReleaseCachedFile(m_strCachedName, m_strContent); }
 
-  if (m_epg.size() == 0)
+  virtual void Run(void)
   {
-    XBMC->Log(LOG_ERROR, "EPG channels not found.");
-    return false;
+    if (!m_data.IsStopped())
+      m_iLength = m_data.GetCachedFileContents(m_strCachedName, m_strUrl, m_strContent, g_bCacheM3U);
   }
 
-  int iMinShiftTime = m_iEPGTimeShift;
-  int iMaxShiftTime = m_iEPGTimeShift;
-  if (!m_bTSOverride)
+  PVRIptvData &m_data;
+  std::string  m_strCachedName;
+  std::string  m_strUrl;
+  std::string  m_strGroup;
+  std::string  m_strContent;
+  int          m_iLength;
+};
+
+int PVRIptvData::LoadXtreamPlayList(const std::string &strCachedName, const std::string &strUrl,
+                                    std::string &strContent, uint64_t &iHash)
+{
+  PVRIptvXtream xtream;
+  if (!xtream.Load(strUrl))
   {
-    iMinShiftTime = SECONDS_IN_DAY;
-    iMaxShiftTime = -SECONDS_IN_DAY;
+    XBMC->Log(LOG_ERROR, "Unable to load playlist '%s': username or password missing.", strUrl.c_str());
+    return 0;
+  }
 
-    std::vector<PVRIptvChannel>::iterator it;
-    for (it = m_channels.begin(); it < m_channels.end(); ++it)
-    {
-      if (it->iTvgShift + m_iEPGTimeShift < iMinShiftTime)
-        iMinShiftTime = it->iTvgShift + m_iEPGTimeShift;
-      if (it->iTvgShift + m_iEPGTimeShift > iMaxShiftTime)
-        iMaxShiftTime = it->iTvgShift + m_iEPGTimeShift;
-    }
+  std::string strCategoriesName = GetXtreamCacheName(strCachedName, "categories");
+  std::string strCategories;
+  std::vector<PVRIptvXtreamCategory> categories;
+  bool bCategories = GetCachedFileContents(strCategoriesName, xtream.GetCategoriesUrl(), strCategories,
+                                           g_bCacheM3U) > 0
+    && PVRIptvXtream::ParseCategories(strCategories.c_str(), strCategories.size(), categories);
+  ReleaseCachedFile(strCategoriesName, strCategories);
+  std::string().swap(strCategories);
+  if (!bCategories)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load categories of playlist '%s'.", strUrl.c_str());
+    return 0;
   }
 
-  PVRIptvEpgChannel *epg = NULL;
-  for(pChannelNode = pRootElement->first_node("programme"); pChannelNode; pChannelNode = pChannelNode->next_sibling("programme"))
+  // categories the filters reject as a whole are never downloaded
+  std::vector<PVRIptvXtreamCategoryJob*> jobs;
+  PVRIptvJobPool pool(std::max<size_t>(std::min<size_t>(categories.size(), XTREAM_MAX_WORKERS), 1));
+  std::vector<PVRIptvXtreamCategory>::iterator category;
+  for (category = categories.begin(); category != categories.end(); ++category)
   {
-    std::string strId;
-    if (!GetAttributeValue(pChannelNode, "channel", strId))
+    if (!m_filter.AcceptGroup(PVRIptvStringRef(category->strName.c_str(), category->strName.size())))
       continue;
 
-    if (NULL == epg || StringUtils::CompareNoCase(epg->strId, strId) != 0)
-    {
-      if ((epg = FindEpg(strId)) == NULL)
-        continue;
-    }
-
-    std::string strStart, strStop;
-    if ( !GetAttributeValue(pChannelNode, "start", strStart)
-      || !GetAttributeValue(pChannelNode, "stop", strStop))
-      continue;
+    std::string strId = StringUtils::Format("%016llx",
+      (unsigned long long)HashString64(category->strId.c_str(), category->strId.size()));
+    PVRIptvXtreamCategoryJob *job = new PVRIptvXtreamCategoryJob(*this, GetXtreamCacheName(strCachedName, strId),
+                                                                 xtream.GetStreamsUrl(category->strId), category->strName);
+    jobs.push_back(job);
+    pool.Add(job);
+  }
+  pool.Wait();
 
-    int iTmpStart = ParseDateTime(strStart);
-    int iTmpEnd = ParseDateTime(strStop);
+  XBMC->Log(LOG_DEBUG, "Loading %u of %u categories of playlist '%s'.", (unsigned int)jobs.size(),
+            (unsigned int)categories.size(), strUrl.c_str());
 
-    if ( (iTmpEnd   + iMaxShiftTime < iStart)
-      || (iTmpStart + iMinShiftTime > iEnd))
-      continue;
+  // the rest of the load sees an ordinary playlist, in category order
+  size_t iLoaded = 0;
+  strContent = M3U_START_MARKER "\n";
+  std::vector<PVRIptvXtreamCategoryJob*>::iterator job;
+  for (job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    if ((*job)->m_iLength == 0)
+      XBMC->Log(LOG_ERROR, "Unable to load category '%s' of playlist '%s'.", (*job)->m_strGroup.c_str(), strUrl.c_str());
+    else if (!xtream.AppendStreams((*job)->m_strContent.c_str(), (*job)->m_strContent.size(), (*job)->m_strGroup, strContent))
+      XBMC->Log(LOG_ERROR, "Invalid category '%s' of playlist '%s'.", (*job)->m_strGroup.c_str(), strUrl.c_str());
+    else
+      iLoaded++;
+    delete *job;
+  }
 
-    PVRIptvEpgEntry entry;
-    entry.iBroadcastId = ++iBroadCastId;
-    entry.iGenreType = 0;
-    entry.iGenreSubType = 0;
-    entry.strPlotOutline = "";
-    entry.startTime = iTmpStart;
-    entry.endTime = iTmpEnd;
+  // a missing category would drop its channels, the loaded ones are kept instead
+  if (iLoaded < jobs.size())
+  {
+    XBMC->Log(LOG_ERROR, "Unable to load %u of %u categories of playlist '%s'.",
+              (unsigned int)(jobs.size() - iLoaded), (unsigned int)jobs.size(), strUrl.c_str());
+    strContent.clear();
+    return 0;
+  }
 
-    GetNodeValue(pChannelNode, "title", entry.strTitle);
-    GetNodeValue(pChannelNode, "desc", entry.strPlot);
-    GetNodeValue(pChannelNode, "category", entry.strGenreString);
+  iHash = HashString64(strContent.c_str(), strContent.size());
+  return strContent.size();
+}
 
-    xml_node<> *pIconNode = pChannelNode->first_node("icon");
-    if (pIconNode == NULL || !GetAttributeValue(pIconNode, "src", entry.strIconPath))
-      entry.strIconPath = "";
+class PVRIptvPlaylistChunkJob : public PVRIptvJob
+{
+public:
+  PVRIptvPlaylistChunkJob(PVRIptvData &data, const char *pData, size_t iLength, int iEPGTimeShift, bool bConvert)
+    : m_data(data), m_pData(pData), m_iLength(iLength), m_iEPGTimeShift(iEPGTimeShift), m_bConvert(bConvert),
+      m_bGroupSeen(false), m_iSkipped(0), m_bResult(false) {}
 
-    epg->epg.push_back(entry);
+  virtual void Run(void)
+  {
+    m_bResult = m_data.ParsePlayListChunk(m_pData, m_iLength, m_iEPGTimeShift, m_bConvert,
+                                          m_entries, m_strLastGroup, m_bGroupSeen, m_iSkipped);
   }
 
-  xmlDoc.clear();
-  LoadGenres();
-
-  XBMC->Log(LOG_NOTICE, "EPG Loaded.");
-
-  if (g_iEPGLogos > 0)
-    ApplyChannelsLogosFromEPG();
+  PVRIptvData                  &m_data;
+  const char                   *m_pData;
+  size_t                        m_iLength;
+  int                           m_iEPGTimeShift;
+  bool                          m_bConvert;
+  std::vector<PVRIptvM3uEntry>  m_entries;
+  PVRIptvStringRef              m_strLastGroup;
+  bool                          m_bGroupSeen;
+  unsigned int                  m_iSkipped;
+  bool                          m_bResult;
+};
 
-  return true;
+/*
+ * Large playlists are cut at #EXTINF lines and the chunks are tokenized,
+ * filtered and converted in parallel. Everything that depends on the
+ * entries before (dedup, numbering, groups) is done afterwards in order,
+ * so the result is the same as a sequential parse.
+ */
+/*
+ * Start of the next "\n#EXTINF" line, the buffer may be a mapped file
+ * without terminating zero.
+ */
+static const char *FindInfoLine(const char *p, const char *pEnd)
+{
+  static const size_t iMarkerLength = sizeof(M3U_INFO_MARKER) - 1;
+  while ((p = (const char *)memchr(p, '\n', pEnd - p)) != NULL)
+  {
+    if ((size_t)(pEnd - p - 1) >= iMarkerLength && memcmp(p + 1, M3U_INFO_MARKER, iMarkerLength) == 0)
+      return p;
+    p++;
+  }
+  return NULL;
 }
 
-bool PVRIptvData::LoadPlayList(void)
+bool PVRIptvData::ParsePlayList(const std::string &strM3uUrl, const char *pData, size_t iLength, int iChannelNum,
+                                std::vector<PVRIptvChannel> &channels, std::vector<PVRIptvChannelGroup> &groups,
+                                PVRIptvGroupIndex &groupIndex, std::set<uint64_t> &streamHashes, std::set<uint64_t> &tvgIdHashes)
 {
-  if (m_strM3uUrl.empty())
+  uint64_t iSliceStart = GetTimeMs();
+  int iNumberOffset = iChannelNum - g_iStartNumber;
+  int iEPGTimeShift = 0;
+
+  PVRIptvM3uTokenizer tokenizer(pData, iLength);
+  PVRIptvStringRef line;
+  if (tokenizer.NextLine(line))
   {
-    XBMC->Log(LOG_NOTICE, "Playlist file path is not configured. Channels not loaded.");
-    return false;
+    if (PVRIptvM3uTokenizer::GetLineType(line) == PVRIptvM3uTokenizer::M3U_LINE_START)
+    {
+      PVRIptvM3uInfo info;
+      PVRIptvM3uTokenizer::ParseInfo(line, info);
+      iEPGTimeShift = (int) (info.strTvgShift.ToDouble() * 3600.0);
+    }
+    else
+    {
+      XBMC->Log(LOG_ERROR,
+                "URL '%s' missing %s descriptor on line 1, attempting to "
+                "parse it anyway.",
+                strM3uUrl.c_str(), M3U_START_MARKER);
+    }
   }
 
-  std::string strPlaylistContent;
-  if (!GetCachedFileContents(M3U_FILE_NAME, m_strM3uUrl, strPlaylistContent, g_bCacheM3U))
+  bool bConvert = !PVRIptvM3uTokenizer::IsUTF8(pData, iLength);
+  if (bConvert)
+    XBMC->Log(LOG_NOTICE, "Playlist '%s' is not UTF-8, converting it.", strM3uUrl.c_str());
+
+  size_t iChunks = std::min((size_t)GetProcessorCount(), iLength / M3U_PARSE_CHUNK_SIZE);
+  if (iChunks < 1)
+    iChunks = 1;
+
+  std::vector<PVRIptvPlaylistChunkJob*> jobs;
+  size_t iChunkStart = 0;
+  for (size_t iChunk = 1; iChunk < iChunks; iChunk++)
   {
-    XBMC->Log(LOG_ERROR, "Unable to load playlist file '%s':  file is missing or empty.", m_strM3uUrl.c_str());
-    return false;
+    size_t iSplit = iChunk * (iLength / iChunks);
+    if (iSplit <= iChunkStart)
+      continue;
+
+    const char *pNext = FindInfoLine(pData + iSplit, pData + iLength);
+    if (pNext == NULL)
+      break;
+
+    size_t iChunkEnd = pNext + 1 - pData;
+    jobs.push_back(new PVRIptvPlaylistChunkJob(*this, pData + iChunkStart, iChunkEnd - iChunkStart, iEPGTimeShift, bConvert));
+    iChunkStart = iChunkEnd;
   }
+  jobs.push_back(new PVRIptvPlaylistChunkJob(*this, pData + iChunkStart, iLength - iChunkStart, iEPGTimeShift, bConvert));
 
-  std::stringstream stream(strPlaylistContent);
+  if (jobs.size() == 1)
+  {
+    jobs[0]->Run();
+  }
+  else
+  {
+    XBMC->Log(LOG_DEBUG, "Parsing playlist '%s' in %u chunks.", strM3uUrl.c_str(), (unsigned int)jobs.size());
 
-  /* load channels */
-  bool bFirst = true;
+    PVRIptvJobPool pool(jobs.size());
+    for (size_t iJob = 0; iJob < jobs.size(); iJob++)
+      pool.Add(jobs[iJob]);
+    pool.Wait();
+  }
 
-  int iChannelIndex     = 0;
-  int iUniqueGroupId    = 0;
+  bool bResult = true;
   int iCurrentGroupId   = 0;
-  int iChannelNum       = g_iStartNumber;
-  int iEPGTimeShift     = 0;
+  unsigned int iSkipped = 0;
+  unsigned int iEntries = 0;
+  std::set<uint64_t> playlistTvgIds;
 
-  PVRIptvChannel tmpChannel;
-  tmpChannel.strTvgId       = "";
-  tmpChannel.strChannelName = "";
-  tmpChannel.strTvgName     = "";
-  tmpChannel.strTvgLogo     = "";
-  tmpChannel.iTvgShift      = 0;
+  // a group-title also applies to the entries without one that follow
+  PVRIptvStringRef strCurrentGroup;
+  PVRIptvStringRef strResolvedGroup;
 
-  char szLine[4096];
-  while(stream.getline(szLine, 4096))
+  for (size_t iJob = 0; iJob < jobs.size(); iJob++)
   {
-    std::string strLine(szLine);
-    strLine = StringUtils::TrimRight(strLine, " \t\r\n");
-    strLine = StringUtils::TrimLeft(strLine, " \t");
-
-    XBMC->Log(LOG_DEBUG, "Read line: '%s'", strLine.c_str());
-
-    if (strLine.empty())
-    {
-      continue;
-    }
+    PVRIptvPlaylistChunkJob *job = jobs[iJob];
+    bResult = bResult && job->m_bResult;
+    iSkipped += job->m_iSkipped;
 
-    if (bFirst)
+    std::vector<PVRIptvM3uEntry>::iterator entry;
+    for (entry = job->m_entries.begin(); bResult && entry != job->m_entries.end(); ++entry)
     {
-      bFirst = false;
-      if (StringUtils::Left(strLine, 3) == "\xEF\xBB\xBF")
+      if ((++iEntries & 0xFF) == 0 && !YieldBackgroundWork(iSliceStart))
       {
-        strLine.erase(0, 3);
+        bResult = false;
+        break;
       }
-      if (StringUtils::Left(strLine, (int)strlen(M3U_START_MARKER)) == M3U_START_MARKER)
+
+      PVRIptvStringRef strGroup = entry->bGroupKnown ? entry->strGroup : strCurrentGroup;
+
+      // entries before the first group-title of a chunk are filtered here
+      if (!entry->bPrepared)
       {
-        double fTvgShift = atof(ReadMarkerValue(strLine, TVG_INFO_SHIFT_MARKER).c_str());
-        iEPGTimeShift = (int) (fTvgShift * 3600.0);
-        continue;
+        if (!m_filter.Accept(strGroup, entry->info.strName, entry->strUrl))
+        {
+          iSkipped++;
+          continue;
+        }
+        PrepareM3uEntry(*entry, iEPGTimeShift, bConvert);
       }
-      else
+
+      if (!entry->info.strTvgChno.empty())
       {
-        XBMC->Log(LOG_ERROR,
-                  "URL '%s' missing %s descriptor on line 1, attempting to "
-                  "parse it anyway.",
-                  m_strM3uUrl.c_str(), M3U_START_MARKER);
+        iChannelNum = entry->info.strTvgChno.ToInt() + iNumberOffset;
       }
-    }
 
-    if (StringUtils::Left(strLine, (int)strlen(M3U_INFO_MARKER)) == M3U_INFO_MARKER)
-    {
-      bool        bRadio       = false;
-      double      fTvgShift    = 0;
-      std::string strChnlNo    = "";
-      std::string strChnlName  = "";
-      std::string strTvgId     = "";
-      std::string strTvgName   = "";
-      std::string strTvgLogo   = "";
-      std::string strTvgShift  = "";
-      std::string strGroupName = "";
-      std::string strRadio     = "";
-
-      // parse line
-      int iColon = (int)strLine.find(':');
-      int iComma = (int)strLine.rfind(',');
-      if (iColon >= 0 && iComma >= 0 && iComma > iColon)
+      // the same stream, or the same tvg-id from an earlier playlist, is kept once
+      bool bDuplicate = !streamHashes.insert(entry->iStreamHash).second
+        || (!entry->info.strTvgId.empty() && tvgIdHashes.find(entry->iTvgIdHash) != tvgIdHashes.end());
+
+      if (!entry->info.strTvgId.empty())
+        playlistTvgIds.insert(entry->iTvgIdHash);
+
+      if (bDuplicate)
       {
-        // parse name
-        iComma++;
-        strChnlName = StringUtils::Right(strLine, (int)strLine.size() - iComma);
-        strChnlName = StringUtils::Trim(strChnlName);
-        tmpChannel.strChannelName = XBMC->UnknownToUTF8(strChnlName.c_str());
-
-        // parse info
-        std::string strInfoLine = StringUtils::Mid(strLine, ++iColon, --iComma - iColon);
-
-        strTvgId      = ReadMarkerValue(strInfoLine, TVG_INFO_ID_MARKER);
-        strTvgName    = ReadMarkerValue(strInfoLine, TVG_INFO_NAME_MARKER);
-        strTvgLogo    = ReadMarkerValue(strInfoLine, TVG_INFO_LOGO_MARKER);
-        strChnlNo     = ReadMarkerValue(strInfoLine, TVG_INFO_CHNO_MARKER);
-        strGroupName  = ReadMarkerValue(strInfoLine, GROUP_NAME_MARKER);
-        strRadio      = ReadMarkerValue(strInfoLine, RADIO_MARKER);
-        strTvgShift   = ReadMarkerValue(strInfoLine, TVG_INFO_SHIFT_MARKER);
-
-        if (strTvgId.empty())
-        {
-          char buff[255];
-          sprintf(buff, "%d", atoi(strInfoLine.c_str()));
-          strTvgId.append(buff);
-        }
-        if (strTvgLogo.empty())
-        {
-          strTvgLogo = strChnlName;
-        }
-        if (!strChnlNo.empty())
-        {
-          iChannelNum = atoi(strChnlNo.c_str());
-        }
-        fTvgShift = atof(strTvgShift.c_str());
+        XBMC->Log(LOG_DEBUG, "Skipping duplicate channel '%s'", entry->channel.strChannelName.c_str());
+        continue;
+      }
 
-        bRadio                = !StringUtils::CompareNoCase(strRadio, "true");
-        tmpChannel.strTvgId   = strTvgId;
-        tmpChannel.strTvgName = XBMC->UnknownToUTF8(strTvgName.c_str());
-        tmpChannel.strTvgLogo = XBMC->UnknownToUTF8(strTvgLogo.c_str());
-        tmpChannel.iTvgShift  = (int)(fTvgShift * 3600.0);
-        tmpChannel.bRadio     = bRadio;
+      // the group is only created once one of its channels is kept
+      if (!strGroup.empty() && !strGroup.Equals(strResolvedGroup.pData, strResolvedGroup.iLength))
+      {
+        std::string strGroupName;
+        AssignUTF8(strGroupName, strGroup, bConvert);
+        strResolvedGroup = strGroup;
 
-        if (strTvgShift.empty())
+        // groups of all playlists are merged by name
+        PVRIptvChannelGroup * pGroup;
+        if ((pGroup = FindGroup(groups, groupIndex, strGroupName)) == NULL)
         {
-          tmpChannel.iTvgShift = iEPGTimeShift;
+          PVRIptvChannelGroup group;
+          group.strGroupName = strGroupName;
+          group.iGroupId = groups.size() + 1;
+          group.bRadio = entry->channel.bRadio;
+
+          groupIndex[strGroupName] = groups.size();
+          groups.push_back(group);
+          iCurrentGroupId = group.iGroupId;
         }
-
-        if (!strGroupName.empty())
+        else
         {
-          strGroupName = XBMC->UnknownToUTF8(strGroupName.c_str());
-
-          PVRIptvChannelGroup * pGroup;
-          if ((pGroup = FindGroup(strGroupName)) == NULL)
-          {
-            PVRIptvChannelGroup group;
-            group.strGroupName = strGroupName;
-            group.iGroupId = ++iUniqueGroupId;
-            group.bRadio = bRadio;
-
-            m_groups.push_back(group);
-            iCurrentGroupId = iUniqueGroupId;
-          }
-          else
-          {
-            iCurrentGroupId = pGroup->iGroupId;
-          }
+          iCurrentGroupId = pGroup->iGroupId;
         }
       }
-    }
-    else if (strLine[0] != '#')
-    {
-      XBMC->Log(LOG_DEBUG,
-                "Found URL: '%s' (current channel name: '%s')",
-                strLine.c_str(), tmpChannel.strChannelName.c_str());
-
-      PVRIptvChannel channel;
-      channel.iUniqueId         = GetChannelId(tmpChannel.strChannelName.c_str(), strLine.c_str());
-      channel.iChannelNumber    = iChannelNum;
-      channel.strTvgId          = tmpChannel.strTvgId;
-      channel.strChannelName    = tmpChannel.strChannelName;
-      channel.strTvgName        = tmpChannel.strTvgName;
-      channel.strTvgLogo        = tmpChannel.strTvgLogo;
-      channel.iTvgShift         = tmpChannel.iTvgShift;
-      channel.bRadio            = tmpChannel.bRadio;
-      channel.strStreamURL      = strLine;
-      channel.iEncryptionSystem = 0;
+
+      channels.push_back(std::move(entry->channel));
+      PVRIptvChannel &channel = channels.back();
+      channel.iChannelNumber = iChannelNum;
 
       iChannelNum++;
 
       if (iCurrentGroupId > 0)
       {
-        channel.bRadio = m_groups.at(iCurrentGroupId - 1).bRadio;
-        m_groups.at(iCurrentGroupId - 1).members.push_back(iChannelIndex);
+        channel.bRadio = groups.at(iCurrentGroupId - 1).bRadio;
+        groups.at(iCurrentGroupId - 1).members.push_back(channels.size() - 1);
       }
+    }
+
+    if (job->m_bGroupSeen)
+      strCurrentGroup = job->m_strLastGroup;
+  }
+
+  for (size_t iJob = 0; iJob < jobs.size(); iJob++)
+    delete jobs[iJob];
+
+  if (!bResult)
+    return false;
+
+  if (iSkipped > 0)
+    XBMC->Log(LOG_NOTICE, "Filtered out %u entries of playlist '%s'.", iSkipped, strM3uUrl.c_str());
+
+  // tvg-ids only count as duplicates in the playlists that follow
+  tvgIdHashes.insert(playlistTvgIds.begin(), playlistTvgIds.end());
+  return true;
+}
+
+bool PVRIptvData::ParsePlayListChunk(const char *pData, size_t iLength, int iEPGTimeShift, bool bConvert,
+                                     std::vector<PVRIptvM3uEntry> &entries, PVRIptvStringRef &strLastGroup,
+                                     bool &bGroupSeen, unsigned int &iSkipped)
+{
+  PVRIptvM3uTokenizer tokenizer(pData, iLength);
+  uint64_t iSliceStart = GetTimeMs();
+  unsigned int iLines  = 0;
+
+  // without group rules the inherited group doesn't matter for filtering
+  bool bNeedGroup = m_filter.UsesGroup();
+  PVRIptvStringRef strCurrentGroup;
+  bGroupSeen = false;
+
+  PVRIptvStringRef     line;
+  PVRIptvM3uInfo       info;
+  PVRIptvM3uProperties properties;
+  while (tokenizer.NextLine(line))
+  {
+    if ((++iLines & 0xFF) == 0 && !YieldBackgroundWork(iSliceStart))
+      return false;
+
+    // the entry only keeps views until its URL line, nothing is copied for
+    // entries that get filtered out
+    PVRIptvM3uTokenizer::LineType lineType = PVRIptvM3uTokenizer::GetLineType(line);
+    if (lineType == PVRIptvM3uTokenizer::M3U_LINE_INFO)
+    {
+      PVRIptvM3uTokenizer::ParseInfo(line, info);
+      continue;
+    }
+    else if (lineType == PVRIptvM3uTokenizer::M3U_LINE_DIRECTIVE)
+    {
+      PVRIptvM3uTokenizer::ParseProperty(line, properties);
+      continue;
+    }
+    else if (lineType != PVRIptvM3uTokenizer::M3U_LINE_URL)
+    {
+      continue;
+    }
 
-      m_channels.push_back(channel);
-      iChannelIndex++;
+    if (!info.strGroupTitle.empty())
+    {
+      strCurrentGroup = info.strGroupTitle;
+      bGroupSeen = true;
+    }
 
-      tmpChannel.strTvgId       = "";
-      tmpChannel.strChannelName = "";
-      tmpChannel.strTvgName     = "";
-      tmpChannel.strTvgLogo     = "";
-      tmpChannel.iTvgShift      = 0;
-      tmpChannel.bRadio         = false;
+    bool bPrepare = bGroupSeen || !bNeedGroup;
+    if (bPrepare && !m_filter.Accept(strCurrentGroup, info.strName, line))
+    {
+      iSkipped++;
+      info = PVRIptvM3uInfo();
+      properties = PVRIptvM3uProperties();
+      continue;
     }
+
+    entries.push_back(PVRIptvM3uEntry());
+    PVRIptvM3uEntry &entry = entries.back();
+    entry.info        = info;
+    entry.properties  = properties;
+    entry.strUrl      = line;
+    entry.strGroup    = strCurrentGroup;
+    entry.bGroupKnown = bGroupSeen;
+    entry.bPrepared   = false;
+    if (bPrepare)
+      PrepareM3uEntry(entry, iEPGTimeShift, bConvert);
+
+    info = PVRIptvM3uInfo();
+    properties = PVRIptvM3uProperties();
   }
 
-  stream.clear();
+  strLastGroup = strCurrentGroup;
+  return true;
+}
+
+void PVRIptvData::PrepareM3uEntry(PVRIptvM3uEntry &entry, int iEPGTimeShift, bool bConvert)
+{
+  PVRIptvM3uInfo &info    = entry.info;
+  PVRIptvChannel &channel = entry.channel;
 
-  if (m_channels.size() == 0)
+  AssignUTF8(channel.strChannelName, info.strName, bConvert);
+  AssignUTF8(channel.strTvgName, info.strTvgName, bConvert);
+  if (info.strTvgLogo.empty())
+    channel.strTvgLogo = channel.strChannelName;
+  else
+    AssignUTF8(channel.strTvgLogo, info.strTvgLogo, bConvert);
+  channel.bHasTvgId = !info.strTvgId.empty();
+  if (!channel.bHasTvgId)
   {
-    XBMC->Log(LOG_ERROR, "Unable to load channels from file '%s':  file is corrupted.", m_strM3uUrl.c_str());
-    return false;
+    char buff[255];
+    sprintf(buff, "%d", info.iDuration);
+    channel.strTvgId = buff;
+  }
+  else
+  {
+    channel.strTvgId.assign(info.strTvgId.pData, info.strTvgId.iLength);
   }
+  channel.strStreamURL.assign(entry.strUrl.pData, entry.strUrl.iLength);
+  channel.strInputFormat = GetInputFormat(entry.properties);
 
-  ApplyChannelsLogos();
+  entry.iStreamHash = HashString64(entry.strUrl.pData, entry.strUrl.iLength);
+  entry.iTvgIdHash  = HashString64(info.strTvgId.pData, info.strTvgId.iLength);
 
-  XBMC->Log(LOG_NOTICE, "Loaded %d channels.", m_channels.size());
-  return true;
+  if (g_iChannelIdMode == CHANNEL_ID_TVG_ID && !info.strTvgId.empty())
+    channel.iUniqueId       = FoldChannelId(entry.iTvgIdHash);
+  else if (g_iChannelIdMode == CHANNEL_ID_TVG_ID || g_iChannelIdMode == CHANNEL_ID_NAME)
+    channel.iUniqueId       = FoldChannelId(HashString64(channel.strChannelName.c_str(), channel.strChannelName.size()));
+  else
+    channel.iUniqueId       = GetChannelId(channel.strChannelName.c_str(), channel.strStreamURL.c_str());
+
+  // legacy ids are made from the plain url, header options come and go
+  AppendUrlOption(channel.strStreamURL, "User-Agent", entry.properties.strUserAgent);
+  AppendUrlOption(channel.strStreamURL, "Referer", entry.properties.strReferrer);
+
+  channel.iChannelNumber    = 0;
+  channel.iTvgShift         = info.strTvgShift.empty() ? iEPGTimeShift :
+                              (int)(info.strTvgShift.ToDouble() * 3600.0);
+  channel.bRadio            = !StringUtils::CompareNoCase(info.strRadio.str(), "true");
+  channel.iEncryptionSystem = 0;
+
+  entry.bPrepared = true;
 }
 
 bool PVRIptvData::LoadGenres(void)
@@ -519,7 +2186,7 @@ bool PVRIptvData::LoadGenres(void)
   if (data.empty())
     return false;
 
-  m_genres.clear();
+  std::vector<PVRIptvEpgGenre> genres;
 
   char* buffer = &(data[0]);
   xml_document<> xmlDoc;
@@ -554,20 +2221,25 @@ bool PVRIptvData::LoadGenres(void)
       && StringUtils::IsNaturalNumber(buff))
       genre.iGenreSubType = atoi(buff.c_str());
 
-    m_genres.push_back(genre);
+    genres.push_back(genre);
   }
 
   xmlDoc.clear();
+
+  CLockObject lock(m_mutex);
+  m_genres.swap(genres);
   return true;
 }
 
 int PVRIptvData::GetChannelsAmount(void)
 {
+  CLockObject lock(m_mutex);
   return m_channels.size();
 }
 
 PVR_ERROR PVRIptvData::GetChannels(ADDON_HANDLE handle, bool bRadio)
 {
+  CLockObject lock(m_mutex);
   for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
   {
     PVRIptvChannel &channel = m_channels.at(iChannelPtr);
@@ -581,6 +2253,7 @@ PVR_ERROR PVRIptvData::GetChannels(ADDON_HANDLE handle, bool bRadio)
       xbmcChannel.iChannelNumber    = channel.iChannelNumber;
       strncpy(xbmcChannel.strChannelName, channel.strChannelName.c_str(), sizeof(xbmcChannel.strChannelName) - 1);
       strncpy(xbmcChannel.strStreamURL, channel.strStreamURL.c_str(), sizeof(xbmcChannel.strStreamURL) - 1);
+      strncpy(xbmcChannel.strInputFormat, channel.strInputFormat.c_str(), sizeof(xbmcChannel.strInputFormat) - 1);
       xbmcChannel.iEncryptionSystem = channel.iEncryptionSystem;
       strncpy(xbmcChannel.strIconPath, channel.strLogoPath.c_str(), sizeof(xbmcChannel.strIconPath) - 1);
       xbmcChannel.bIsHidden         = false;
@@ -594,33 +2267,32 @@ PVR_ERROR PVRIptvData::GetChannels(ADDON_HANDLE handle, bool bRadio)
 
 bool PVRIptvData::GetChannel(const PVR_CHANNEL &channel, PVRIptvChannel &myChannel)
 {
-  for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
-  {
-    PVRIptvChannel &thisChannel = m_channels.at(iChannelPtr);
-    if (thisChannel.iUniqueId == (int) channel.iUniqueId)
-    {
-      myChannel.iUniqueId         = thisChannel.iUniqueId;
-      myChannel.bRadio            = thisChannel.bRadio;
-      myChannel.iChannelNumber    = thisChannel.iChannelNumber;
-      myChannel.iEncryptionSystem = thisChannel.iEncryptionSystem;
-      myChannel.strChannelName    = thisChannel.strChannelName;
-      myChannel.strLogoPath       = thisChannel.strLogoPath;
-      myChannel.strStreamURL      = thisChannel.strStreamURL;
+  CLockObject lock(m_mutex);
+  PVRIptvChannel *thisChannel;
+  if ((thisChannel = FindChannelById(channel.iUniqueId)) == NULL)
+    return false;
 
-      return true;
-    }
-  }
+  myChannel.iUniqueId         = thisChannel->iUniqueId;
+  myChannel.bRadio            = thisChannel->bRadio;
+  myChannel.iChannelNumber    = thisChannel->iChannelNumber;
+  myChannel.iEncryptionSystem = thisChannel->iEncryptionSystem;
+  myChannel.strChannelName    = thisChannel->strChannelName;
+  myChannel.strLogoPath       = thisChannel->strLogoPath;
+  myChannel.strStreamURL      = thisChannel->strStreamURL;
+  myChannel.strInputFormat    = thisChannel->strInputFormat;
 
-  return false;
+  return true;
 }
 
 int PVRIptvData::GetChannelGroupsAmount(void)
 {
+  CLockObject lock(m_mutex);
   return m_groups.size();
 }
 
 PVR_ERROR PVRIptvData::GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
 {
+  CLockObject lock(m_mutex);
   std::vector<PVRIptvChannelGroup>::iterator it;
   for (it = m_groups.begin(); it != m_groups.end(); ++it)
   {
@@ -629,139 +2301,298 @@ PVR_ERROR PVRIptvData::GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
       PVR_CHANNEL_GROUP xbmcGroup;
       memset(&xbmcGroup, 0, sizeof(PVR_CHANNEL_GROUP));
 
-      xbmcGroup.iPosition = 0;      /* not supported  */
-      xbmcGroup.bIsRadio  = bRadio; /* is radio group */
-      strncpy(xbmcGroup.strGroupName, it->strGroupName.c_str(), sizeof(xbmcGroup.strGroupName) - 1);
+      xbmcGroup.iPosition = 0;      /* not supported  */
+      xbmcGroup.bIsRadio  = bRadio; /* is radio group */
+      strncpy(xbmcGroup.strGroupName, it->strGroupName.c_str(), sizeof(xbmcGroup.strGroupName) - 1);
+
+      PVR->TransferChannelGroup(handle, &xbmcGroup);
+    }
+  }
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRIptvData::GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &group)
+{
+  CLockObject lock(m_mutex);
+  PVRIptvChannelGroup *myGroup;
+  if ((myGroup = FindGroup(m_groups, m_groupIndex, group.strGroupName)) != NULL)
+  {
+    std::vector<int>::iterator it;
+    for (it = myGroup->members.begin(); it != myGroup->members.end(); ++it)
+    {
+      if ((*it) < 0 || (*it) >= (int)m_channels.size())
+        continue;
+
+      PVRIptvChannel &channel = m_channels.at(*it);
+      PVR_CHANNEL_GROUP_MEMBER xbmcGroupMember;
+      memset(&xbmcGroupMember, 0, sizeof(PVR_CHANNEL_GROUP_MEMBER));
+
+      strncpy(xbmcGroupMember.strGroupName, group.strGroupName, sizeof(xbmcGroupMember.strGroupName) - 1);
+      xbmcGroupMember.iChannelUniqueId = channel.iUniqueId;
+      xbmcGroupMember.iChannelNumber   = channel.iChannelNumber;
+
+      PVR->TransferChannelGroupMember(handle, &xbmcGroupMember);
+    }
+  }
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRIptvData::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channel, time_t iStart, time_t iEnd)
+{
+  CLockObject lock(m_mutex);
+
+  PVRIptvChannel *myChannel;
+  if ((myChannel = FindChannelById(channel.iUniqueId)) == NULL)
+    return PVR_ERROR_NO_ERROR;
+
+  if (iStart < m_iLastStart || iEnd > m_iLastEnd)
+  {
+    // reload EPG for new time interval only, meanwhile serve what we have
+    RequestEPGLoad(iStart, iEnd);
+  }
+
+  PVRIptvEpgChannel *epg;
+  if ((epg = FindEpgForChannel(m_epg, *myChannel)) == NULL || epg->epg.size() == 0)
+    return PVR_ERROR_NO_ERROR;
+
+  int iShift = m_bTSOverride ? m_iEPGTimeShift : myChannel->iTvgShift + m_iEPGTimeShift;
+
+  std::vector<PVRIptvEpgEntry>::iterator myTag;
+  for (myTag = epg->epg.begin(); myTag < epg->epg.end(); ++myTag)
+  {
+    if ((myTag->endTime + iShift) < iStart)
+      continue;
 
-      PVR->TransferChannelGroup(handle, &xbmcGroup);
+    int iGenreType, iGenreSubType;
+
+    EPG_TAG tag;
+    memset(&tag, 0, sizeof(EPG_TAG));
+
+    tag.iUniqueBroadcastId  = myTag->iBroadcastId;
+    tag.strTitle            = myTag->strTitle.c_str();
+    tag.iChannelNumber      = myTag->iChannelId;
+    tag.startTime           = myTag->startTime + iShift;
+    tag.endTime             = myTag->endTime + iShift;
+    tag.strPlotOutline      = myTag->strPlotOutline.c_str();
+    tag.strPlot             = myTag->strPlot.c_str();
+    tag.strOriginalTitle    = NULL;  /* not supported */
+    tag.strCast             = NULL;  /* not supported */
+    tag.strDirector         = NULL;  /* not supported */
+    tag.strWriter           = NULL;  /* not supported */
+    tag.iYear               = 0;     /* not supported */
+    tag.strIMDBNumber       = NULL;  /* not supported */
+    tag.strIconPath         = myTag->strIconPath.c_str();
+    if (FindEpgGenre(myTag->strGenreString, iGenreType, iGenreSubType))
+    {
+      tag.iGenreType          = iGenreType;
+      tag.iGenreSubType       = iGenreSubType;
+      tag.strGenreDescription = NULL;
+    }
+    else
+    {
+      tag.iGenreType          = EPG_GENRE_USE_STRING;
+      tag.iGenreSubType       = 0;     /* not supported */
+      tag.strGenreDescription = myTag->strGenreString.c_str();
     }
+    tag.iParentalRating     = 0;     /* not supported */
+    tag.iStarRating         = 0;     /* not supported */
+    tag.bNotify             = false; /* not supported */
+    tag.iSeriesNumber       = 0;     /* not supported */
+    tag.iEpisodeNumber      = 0;     /* not supported */
+    tag.iEpisodePartNumber  = 0;     /* not supported */
+    tag.strEpisodeName      = NULL;  /* not supported */
+    tag.iFlags              = EPG_TAG_FLAG_UNDEFINED;
+
+    PVR->TransferEpgEntry(handle, &tag);
+
+    if ((myTag->startTime + iShift) > iEnd)
+      break;
   }
 
   return PVR_ERROR_NO_ERROR;
 }
 
-PVR_ERROR PVRIptvData::GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &group)
+/*
+ * Appends an opened file up to its end, straight into the string which is
+ * sized up front when the length is known.
+ */
+/*
+ * Reads to the end of the file, false when a read failed on the way
+ */
+static bool ReadOpenedFile(void *fileHandle, std::string &strContent, PVRIptvContentHasher *pHasher)
 {
-  PVRIptvChannelGroup *myGroup;
-  if ((myGroup = FindGroup(group.strGroupName)) != NULL)
+  int64_t iFileLength = XBMC->GetFileLength(fileHandle);
+  size_t iRead = strContent.size();
+  size_t iSize = iFileLength > 0 ? iRead + (size_t)iFileLength : 0;
+  strContent.resize(std::max(iSize, iRead + FILE_READ_SIZE));
+
+  ssize_t bytesRead;
+  for (;;)
   {
-    std::vector<int>::iterator it;
-    for (it = myGroup->members.begin(); it != myGroup->members.end(); ++it)
-    {
-      if ((*it) < 0 || (*it) >= (int)m_channels.size())
-        continue;
+    if (strContent.size() - iRead < FILE_READ_SIZE)
+      strContent.resize(std::max(strContent.size() * 2, iRead + FILE_READ_SIZE));
 
-      PVRIptvChannel &channel = m_channels.at(*it);
-      PVR_CHANNEL_GROUP_MEMBER xbmcGroupMember;
-      memset(&xbmcGroupMember, 0, sizeof(PVR_CHANNEL_GROUP_MEMBER));
+    bytesRead = XBMC->ReadFile(fileHandle, &strContent[iRead], FILE_READ_SIZE);
+    if (bytesRead <= 0)
+      break;
+    if (pHasher)
+      pHasher->Update(&strContent[iRead], bytesRead);
+    iRead += bytesRead;
+  }
+  strContent.resize(iRead);
+  return bytesRead == 0;
+}
 
-      strncpy(xbmcGroupMember.strGroupName, group.strGroupName, sizeof(xbmcGroupMember.strGroupName) - 1);
-      xbmcGroupMember.iChannelUniqueId = channel.iUniqueId;
-      xbmcGroupMember.iChannelNumber   = channel.iChannelNumber;
+int PVRIptvData::GetFileContents(std::string& url, std::string &strContent, uint64_t *pHash /* NULL */,
+                                 PVRIptvMappedFile *pMapped /* NULL */)
+{
+  strContent.clear();
 
-      PVR->TransferChannelGroupMember(handle, &xbmcGroupMember);
+  // only our own caches are mapped, they are replaced whole and never
+  // truncated under a reader, a user file could be and would fault the mapping
+  if (pMapped && PVRIptvMappedFile::IsLocalPath(url) && pMapped->Open(url))
+  {
+    if (pHash)
+    {
+      PVRIptvContentHasher hasher;
+      hasher.Update(pMapped->Data(), pMapped->Size());
+      *pHash = hasher.Final();
     }
+    return pMapped->Size();
   }
 
-  return PVR_ERROR_NO_ERROR;
+  int iStatus;
+  PVRIptvContentHasher hasher;
+  void* fileHandle = PVRIptvHttp::IsHttpUrl(url) ?
+    PVRIptvHttp::Open(url, PVRIptvHttpValidators(), iStatus) : XBMC->OpenFile(url.c_str(), 0);
+  if (fileHandle)
+  {
+    // part of a file is worse than none
+    if (!ReadOpenedFile(fileHandle, strContent, pHash ? &hasher : NULL))
+    {
+      XBMC->Log(LOG_ERROR, "Unable to read '%s'.", url.c_str());
+      strContent.clear();
+    }
+    XBMC->CloseFile(fileHandle);
+  }
+
+  if (pHash)
+    *pHash = hasher.Final();
+
+  return strContent.length();
 }
 
-PVR_ERROR PVRIptvData::GetEPGForChannel(ADDON_HANDLE handle, const PVR_CHANNEL &channel, time_t iStart, time_t iEnd)
+int PVRIptvData::DownloadFile(const std::string &strUrl, const std::string &strCachedPath, bool bConditional,
+                              std::string &strContents, uint64_t &iHash, PVRIptvHttpValidators &validators,
+                              bool &bNotModified)
 {
-  std::vector<PVRIptvChannel>::iterator myChannel;
-  for (myChannel = m_channels.begin(); myChannel < m_channels.end(); ++myChannel)
+  std::string strFilePath = strUrl;
+  bNotModified = false;
+  validators = PVRIptvHttpValidators();
+
+  if (!PVRIptvHttp::IsHttpUrl(strUrl))
+    return GetFileContents(strFilePath, strContents, &iHash);
+
+  std::string strPartPath = strCachedPath + CACHE_PART_EXTENSION;
+  PVRIptvContentHasher hasher;
+  void *fileHandle = NULL;
+  int iStatus = 0;
+  int64_t iExpected = -1;
+  strContents.clear();
+
+  // continue an interrupted download, as long as the file is the same
+  PVRIptvHttpValidators partValidators;
+  std::string strPartValidatorsPath = strPartPath + CACHE_HTTP_EXTENSION;
+  if (PVRIptvHttp::ReadValidators(strPartValidatorsPath, partValidators) &&
+      GetFileContents(strPartPath, strContents) > 0)
   {
-    if (myChannel->iUniqueId != (int) channel.iUniqueId)
-      continue;
-
-    if (iStart > m_iLastStart || iEnd > m_iLastEnd)
+    int64_t iStart, iTotal;
+    fileHandle = PVRIptvHttp::Open(strUrl, partValidators, iStatus, strContents.size());
+    if (fileHandle && iStatus == HTTP_STATUS_PARTIAL_CONTENT &&
+        PVRIptvHttp::GetContentRange(fileHandle, iStart, iTotal) && iStart == (int64_t)strContents.size())
+    {
+      XBMC->Log(LOG_NOTICE, "Resuming download of '%s' at %llu bytes.", strUrl.c_str(),
+                (unsigned long long)strContents.size());
+      validators = partValidators;
+      iExpected  = iTotal;
+      hasher.Update(strContents.c_str(), strContents.size());
+    }
+    else
     {
-      // reload EPG for new time interval only
-      LoadEPG(iStart, iEnd);
+      // anything but the whole new file is of no use
+      strContents.clear();
+      if (fileHandle && iStatus != HTTP_STATUS_OK)
       {
-        // doesn't matter is epg loaded or not we shouldn't try to load it for same interval
-        m_iLastStart = iStart;
-        m_iLastEnd = iEnd;
+        XBMC->CloseFile(fileHandle);
+        fileHandle = NULL;
       }
     }
 
-    PVRIptvEpgChannel *epg;
-    if ((epg = FindEpgForChannel(*myChannel)) == NULL || epg->epg.size() == 0)
-      return PVR_ERROR_NO_ERROR;
+    // written again if this download is interrupted too
+    XBMC->DeleteFile(strPartValidatorsPath.c_str());
+    XBMC->DeleteFile(strPartPath.c_str());
+  }
 
-    int iShift = m_bTSOverride ? m_iEPGTimeShift : myChannel->iTvgShift + m_iEPGTimeShift;
+  if (!fileHandle)
+  {
+    // ask only for a changed file when the cache can answer otherwise
+    PVRIptvHttpValidators cachedValidators;
+    if (bConditional)
+      PVRIptvHttp::ReadValidators(strCachedPath + CACHE_HTTP_EXTENSION, cachedValidators);
 
-    std::vector<PVRIptvEpgEntry>::iterator myTag;
-    for (myTag = epg->epg.begin(); myTag < epg->epg.end(); ++myTag)
-    {
-      if ((myTag->endTime + iShift) < iStart)
-        continue;
+    fileHandle = PVRIptvHttp::Open(strUrl, cachedValidators, iStatus);
+    if (!fileHandle)
+      return 0;
 
-      int iGenreType, iGenreSubType;
-
-      EPG_TAG tag;
-      memset(&tag, 0, sizeof(EPG_TAG));
-
-      tag.iUniqueBroadcastId  = myTag->iBroadcastId;
-      tag.strTitle            = myTag->strTitle.c_str();
-      tag.iChannelNumber      = myTag->iChannelId;
-      tag.startTime           = myTag->startTime + iShift;
-      tag.endTime             = myTag->endTime + iShift;
-      tag.strPlotOutline      = myTag->strPlotOutline.c_str();
-      tag.strPlot             = myTag->strPlot.c_str();
-      tag.strOriginalTitle    = NULL;  /* not supported */
-      tag.strCast             = NULL;  /* not supported */
-      tag.strDirector         = NULL;  /* not supported */
-      tag.strWriter           = NULL;  /* not supported */
-      tag.iYear               = 0;     /* not supported */
-      tag.strIMDBNumber       = NULL;  /* not supported */
-      tag.strIconPath         = myTag->strIconPath.c_str();
-      if (FindEpgGenre(myTag->strGenreString, iGenreType, iGenreSubType))
-      {
-        tag.iGenreType          = iGenreType;
-        tag.iGenreSubType       = iGenreSubType;
-        tag.strGenreDescription = NULL;
-      }
-      else
-      {
-        tag.iGenreType          = EPG_GENRE_USE_STRING;
-        tag.iGenreSubType       = 0;     /* not supported */
-        tag.strGenreDescription = myTag->strGenreString.c_str();
-      }
-      tag.iParentalRating     = 0;     /* not supported */
-      tag.iStarRating         = 0;     /* not supported */
-      tag.bNotify             = false; /* not supported */
-      tag.iSeriesNumber       = 0;     /* not supported */
-      tag.iEpisodeNumber      = 0;     /* not supported */
-      tag.iEpisodePartNumber  = 0;     /* not supported */
-      tag.strEpisodeName      = NULL;  /* not supported */
-      tag.iFlags              = EPG_TAG_FLAG_UNDEFINED;
-
-      PVR->TransferEpgEntry(handle, &tag);
-
-      if ((myTag->startTime + iShift) > iEnd)
-        break;
+    if (iStatus == HTTP_STATUS_NOT_MODIFIED && !cachedValidators.IsEmpty())
+    {
+      PVRIptvHttp::GetValidators(fileHandle, validators);
+      XBMC->CloseFile(fileHandle);
+      bNotModified = true;
+      return 0;
     }
+  }
 
-    return PVR_ERROR_NO_ERROR;
+  // a resumed transfer is never encoded, see PVRIptvHttp::Open()
+  bool bIdentity = true;
+  if (strContents.empty())
+  {
+    PVRIptvHttp::GetValidators(fileHandle, validators);
+    // a transfer inflated by curl can't be measured nor continued
+    bIdentity = PVRIptvHttp::IsIdentityEncoded(fileHandle);
+    if (bIdentity)
+      iExpected = XBMC->GetFileLength(fileHandle);
   }
 
-  return PVR_ERROR_NO_ERROR;
-}
+  bool bComplete = ReadOpenedFile(fileHandle, strContents, &hasher);
+  XBMC->CloseFile(fileHandle);
 
-int PVRIptvData::GetFileContents(std::string& url, std::string &strContent)
-{
-  strContent.clear();
-  void* fileHandle = XBMC->OpenFile(url.c_str(), 0);
-  if (fileHandle)
+  // a short file must not replace the cached one
+  if (!bComplete || (iExpected > 0 && (int64_t)strContents.size() < iExpected))
   {
-    char buffer[1024];
-    while (int bytesRead = XBMC->ReadFile(fileHandle, buffer, 1024))
-      strContent.append(buffer, bytesRead);
-    XBMC->CloseFile(fileHandle);
+    XBMC->Log(LOG_ERROR, "Download of '%s' interrupted after %llu of %lld bytes.", strUrl.c_str(),
+              (unsigned long long)strContents.size(), (long long)iExpected);
+
+    // kept for the next try, the validators are written last
+    void *partHandle;
+    if (bIdentity && validators.IsStrong() &&
+        (partHandle = XBMC->OpenFileForWrite(strPartPath.c_str(), true)) != NULL)
+    {
+      bool bWritten = XBMC->WriteFile(partHandle, strContents.c_str(), strContents.length()) ==
+                      (ssize_t)strContents.length();
+      XBMC->CloseFile(partHandle);
+      if (bWritten)
+        PVRIptvHttp::WriteValidators(strPartValidatorsPath, validators);
+    }
+
+    strContents.clear();
+    return 0;
   }
 
-  return strContent.length();
+  iHash = hasher.Final();
+  return strContents.length();
 }
 
 int PVRIptvData::ParseDateTime(std::string& strDate, bool iDateFormat)
@@ -799,13 +2630,23 @@ int PVRIptvData::ParseDateTime(std::string& strDate, bool iDateFormat)
   return mktime(&timeinfo) - offset_of_date - offset;
 }
 
-PVRIptvChannel * PVRIptvData::FindChannel(const std::string &strId, const std::string &strName)
+PVRIptvChannel * PVRIptvData::FindChannelById(int iUniqueId)
+{
+  PVRIptvChannelIndex::const_iterator it = m_channelIndex.find(iUniqueId);
+  if (it == m_channelIndex.end() || it->second >= m_channels.size())
+    return NULL;
+
+  return &m_channels.at(it->second);
+}
+
+PVRIptvChannel * PVRIptvData::FindChannel(std::vector<PVRIptvChannel> &channels, const std::string &strId,
+                                           const std::string &strName)
 {
   std::string strTvgName = strName;
   StringUtils::Replace(strTvgName, ' ', '_');
 
   std::vector<PVRIptvChannel>::iterator it;
-  for(it = m_channels.begin(); it < m_channels.end(); ++it)
+  for(it = channels.begin(); it < channels.end(); ++it)
   {
     if (it->strTvgId == strId)
       return &*it;
@@ -823,22 +2664,20 @@ PVRIptvChannel * PVRIptvData::FindChannel(const std::string &strId, const std::s
   return NULL;
 }
 
-PVRIptvChannelGroup * PVRIptvData::FindGroup(const std::string &strName)
+PVRIptvChannelGroup * PVRIptvData::FindGroup(std::vector<PVRIptvChannelGroup> &groups, PVRIptvGroupIndex &groupIndex,
+                                              const std::string &strName)
 {
-  std::vector<PVRIptvChannelGroup>::iterator it;
-  for(it = m_groups.begin(); it < m_groups.end(); ++it)
-  {
-    if (it->strGroupName == strName)
-      return &*it;
-  }
+  PVRIptvGroupIndex::const_iterator it = groupIndex.find(strName);
+  if (it == groupIndex.end() || it->second >= groups.size())
+    return NULL;
 
-  return NULL;
+  return &groups.at(it->second);
 }
 
-PVRIptvEpgChannel * PVRIptvData::FindEpg(const std::string &strId)
+PVRIptvEpgChannel * PVRIptvData::FindEpg(std::vector<PVRIptvEpgChannel> &epg, const std::string &strId)
 {
   std::vector<PVRIptvEpgChannel>::iterator it;
-  for(it = m_epg.begin(); it < m_epg.end(); ++it)
+  for(it = epg.begin(); it < epg.end(); ++it)
   {
     if (StringUtils::CompareNoCase(it->strId, strId) == 0)
       return &*it;
@@ -847,10 +2686,10 @@ PVRIptvEpgChannel * PVRIptvData::FindEpg(const std::string &strId)
   return NULL;
 }
 
-PVRIptvEpgChannel * PVRIptvData::FindEpgForChannel(PVRIptvChannel &channel)
+PVRIptvEpgChannel * PVRIptvData::FindEpgForChannel(std::vector<PVRIptvEpgChannel> &epg, PVRIptvChannel &channel)
 {
   std::vector<PVRIptvEpgChannel>::iterator it;
-  for(it = m_epg.begin(); it < m_epg.end(); ++it)
+  for(it = epg.begin(); it < epg.end(); ++it)
   {
     if (it->strId == channel.strTvgId)
       return &*it;
@@ -888,86 +2727,70 @@ bool PVRIptvData::FindEpgGenre(const std::string& strGenre, int& iType, int& iSu
 }
 
 /*
- * This method uses zlib to decompress a gzipped file in memory.
- * Author: Andrew Lim Chong Liang
- * http://windrealm.org
+ * Packs into a gzip stream at the fastest level, cache files are written
+ * often and read back once.
  */
-bool PVRIptvData::GzipInflate( const std::string& compressedBytes, std::string& uncompressedBytes ) {
-
-#define HANDLE_CALL_ZLIB(status) {   \
-  if(status != Z_OK) {        \
-    free(uncomp);             \
-    return false;             \
-  }                           \
-}
-
-  if ( compressedBytes.size() == 0 )
-  {
-    uncompressedBytes = compressedBytes ;
-    return true ;
-  }
-
-  uncompressedBytes.clear() ;
-
-  unsigned full_length = compressedBytes.size() ;
-  unsigned half_length = compressedBytes.size() / 2;
-
-  unsigned uncompLength = full_length ;
-  char* uncomp = (char*) calloc( sizeof(char), uncompLength );
-
+bool PVRIptvData::GzipDeflate(const std::string &uncompressedBytes, std::string &compressedBytes)
+{
   z_stream strm;
-  strm.next_in = (Bytef *) compressedBytes.c_str();
-  strm.avail_in = compressedBytes.size() ;
-  strm.total_out = 0;
-  strm.zalloc = Z_NULL;
-  strm.zfree = Z_NULL;
+  memset(&strm, 0, sizeof(strm));
+  if (deflateInit2(&strm, 1, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
 
-  bool done = false ;
+  compressedBytes.resize(deflateBound(&strm, uncompressedBytes.size()));
 
-  HANDLE_CALL_ZLIB(inflateInit2(&strm, (16+MAX_WBITS)));
+  const char *pIn  = uncompressedBytes.c_str();
+  size_t      iIn  = uncompressedBytes.size();
+  size_t      iOut = 0;
+  int         err  = Z_OK;
 
-  while (!done)
+  // avail_in and avail_out are 32 bit, large inputs are fed in slices
+  while (err == Z_OK)
   {
-    // If our output buffer is too small
-    if (strm.total_out >= uncompLength )
+    if (strm.avail_in == 0 && iIn > 0)
     {
-      // Increase size of output buffer
-      uncomp = (char *) realloc(uncomp, uncompLength + half_length);
-      if (uncomp == NULL)
-        return false;
-      uncompLength += half_length ;
+      strm.next_in  = (Bytef *)pIn;
+      strm.avail_in = (uInt)std::min(iIn, (size_t)(1 << 30));
+      pIn += strm.avail_in;
+      iIn -= strm.avail_in;
     }
+    if (compressedBytes.size() == iOut)
+      compressedBytes.resize(iOut + FILE_READ_SIZE);
 
-    strm.next_out = (Bytef *) (uncomp + strm.total_out);
-    strm.avail_out = uncompLength - strm.total_out;
+    strm.next_out  = (Bytef *)&compressedBytes[iOut];
+    strm.avail_out = (uInt)std::min(compressedBytes.size() - iOut, (size_t)(1 << 30));
+    uInt iAvailable = strm.avail_out;
 
-    // Inflate another chunk.
-    int err = inflate (&strm, Z_SYNC_FLUSH);
-    if (err == Z_STREAM_END)
-      done = true;
-    else if (err != Z_OK)
-    {
-      break;
-    }
+    err = deflate(&strm, iIn == 0 ? Z_FINISH : Z_NO_FLUSH);
+    iOut += iAvailable - strm.avail_out;
   }
+  deflateEnd(&strm);
 
-  HANDLE_CALL_ZLIB(inflateEnd (&strm));
-
-  for ( size_t i=0; i<strm.total_out; ++i )
-  {
-    uncompressedBytes += uncomp[ i ];
-  }
+  if (err != Z_STREAM_END)
+    return false;
 
-  free( uncomp );
-  return true ;
+  compressedBytes.resize(iOut);
+  return true;
 }
 
 int PVRIptvData::GetCachedFileContents(const std::string &strCachedName, const std::string &filePath,
-                                       std::string &strContents, const bool bUseCache /* false */)
+                                       std::string &strContents, const bool bUseCache /* false */,
+                                       PVRIptvCacheType cacheType /* IPTV_CACHE_PLAYLIST */,
+                                       uint64_t *pHash /* NULL */, PVRIptvMappedFile *pMapped /* NULL */,
+                                       bool *pExpired /* NULL */)
 {
   bool bNeedReload = false;
+  bool bRevalidate = false;
+  bool bCacheExists = false;
   std::string strCachedPath = GetUserFilePath(strCachedName);
+  std::string strHashPath = strCachedPath + CACHE_HASH_EXTENSION;
   std::string strFilePath = filePath;
+  uint64_t iCachedHash = 0;
+  bool bHaveHash = false;
+
+  // a copy of a local file is of no use, it is read as it is
+  if (PVRIptvMappedFile::IsLocalPath(strFilePath))
+    return GetFileContents(strFilePath, strContents, pHash);
 
   // check cached file is exists
   if (bUseCache && XBMC->FileExists(strCachedPath.c_str(), false))
@@ -975,45 +2798,329 @@ int PVRIptvData::GetCachedFileContents(const std::string &strCachedName, const s
     struct __stat64 statCached;
     struct __stat64 statOrig;
 
-    XBMC->StatFile(strCachedPath.c_str(), &statCached);
-    XBMC->StatFile(strFilePath.c_str(), &statOrig);
+    // the hash file is rewritten on every download, the cache itself only
+    // when the content changed
+    bHaveHash = ReadCacheHash(strHashPath, iCachedHash);
 
-    bNeedReload = statCached.st_mtime < statOrig.st_mtime || statOrig.st_mtime == 0;
+    memset(&statCached, 0, sizeof(statCached));
+    memset(&statOrig, 0, sizeof(statOrig));
+    XBMC->StatFile(bHaveHash ? strHashPath.c_str() : strCachedPath.c_str(), &statCached);
+    XBMC->StatFile(strFilePath.c_str(), &statOrig);
+    bCacheExists = true;
+
+    // remote files rarely have a modification time, the cache is then
+    // trusted for its time to live
+    if (statOrig.st_mtime != 0)
+      bNeedReload = statCached.st_mtime < statOrig.st_mtime;
+    else
+      bNeedReload = time(NULL) - statCached.st_mtime >= (time_t)g_iCacheTtl * 60;
+
+    // an expired copy is served right away while it is replaced, without
+    // time to live there is nothing to serve
+    if (bNeedReload && g_bCacheStaleRevalidate && g_iCacheTtl > 0)
+    {
+      bNeedReload = false;
+      bRevalidate = true;
+    }
   }
   else
     bNeedReload = true;
 
   if (bNeedReload)
   {
-    GetFileContents(strFilePath, strContents);
+    uint64_t iHash = 0;
+    bool bNotModified;
+    PVRIptvHttpValidators validators;
+    DownloadFile(strFilePath, strCachedPath, bCacheExists && bHaveHash, strContents, iHash, validators, bNotModified);
 
-    // write to cache
-    if (bUseCache && strContents.length() > 0)
+    if (bNotModified)
     {
-      void* fileHandle = XBMC->OpenFileForWrite(strCachedPath.c_str(), true);
-      if (fileHandle)
-      {
-        XBMC->WriteFile(fileHandle, strContents.c_str(), strContents.length());
-        XBMC->CloseFile(fileHandle);
-      }
+      // the cache is still good, its time to live starts again
+      XBMC->Log(LOG_DEBUG, "'%s' is not modified.", strFilePath.c_str());
+      StoreCachedFile(strCachedPath, strContents, iCachedHash, true, validators);
+    }
+    else if (strContents.length() > 0)
+    {
+      // write to cache
+      if (bUseCache)
+        StoreCachedFile(strCachedPath, strContents, iHash, bCacheExists && bHaveHash && iHash == iCachedHash,
+                        validators);
+
+      if (pHash)
+        *pHash = iHash;
+      return strContents.length();
+    }
+    else if (!bCacheExists)
+      return 0;
+    else
+    {
+      // better an old copy than nothing
+      XBMC->Log(LOG_NOTICE, "Unable to refresh '%s', using cached copy.", strFilePath.c_str());
+    }
+  }
+  else if (bRevalidate && pExpired)
+  {
+    // the caller refreshes it together with others
+    *pExpired = true;
+  }
+  else if (bRevalidate)
+  {
+    CLockObject lock(m_mutex);
+    if (m_refreshing.insert(strCachedName).second)
+    {
+      XBMC->Log(LOG_DEBUG, "Cached copy of '%s' expired, refreshing it in background.", strFilePath.c_str());
+      m_refreshPool->Add(new PVRIptvCacheRefreshJob(*this, strCachedName, strFilePath, cacheType));
+    }
+  }
+
+  if (bHaveHash && pHash)
+  {
+    *pHash = iCachedHash;
+    return ReadCachedFile(strCachedPath, strContents, cacheType, NULL, pMapped);
+  }
+
+  return ReadCachedFile(strCachedPath, strContents, cacheType, pHash, pMapped);
+}
+
+bool PVRIptvData::ReadCacheHash(const std::string &strHashPath, uint64_t &iHash)
+{
+  std::string strHash;
+  std::string strPath = strHashPath;
+  if (!XBMC->FileExists(strPath.c_str(), false) || GetFileContents(strPath, strHash) == 0)
+    return false;
+
+  iHash = strtoull(strHash.c_str(), NULL, 16);
+  return true;
+}
+
+void PVRIptvData::StoreCachedFile(const std::string &strCachedPath, const std::string &strContents, uint64_t iHash,
+                                  bool bUnchanged, const PVRIptvHttpValidators &validators)
+{
+  // the load goes on with the download, the writer gets the packed copy, a
+  // file stored as it is waits until the load hands it over, see ReleaseCachedFile()
+  std::string strPacked;
+  bool bWaiting = !bUnchanged && !PackCachedFile(strCachedPath, strContents, strPacked);
+  PVRIptvCacheWriteJob *job = new PVRIptvCacheWriteJob(*this, strCachedPath, strPacked, iHash, bUnchanged,
+                                                       validators, NextCacheWrite(strCachedPath));
+  if (!bWaiting)
+  {
+    m_cacheWritePool->Add(job);
+    return;
+  }
+
+  CLockObject lock(m_cacheSequenceMutex);
+  PVRIptvCacheWriteJob *&waiting = m_waitingWrites[strCachedPath];
+  // an older download of the same file was never handed over, it is outdated now
+  delete waiting;
+  waiting = job;
+}
+
+unsigned int PVRIptvData::NextCacheWrite(const std::string &strCachedPath)
+{
+  CLockObject lock(m_cacheSequenceMutex);
+  return ++m_cacheWriteSequence[strCachedPath];
+}
+
+void PVRIptvData::ReleaseCachedFile(const std::string &strCachedName, std::string &strContents,
+                                    bool bCopy /* false */)
+{
+  // the caller is done with the contents, unless they are copied
+  CLockObject lock(m_cacheSequenceMutex);
+  std::unordered_map<std::string, PVRIptvCacheWriteJob*>::iterator it =
+    m_waitingWrites.find(GetUserFilePath(strCachedName));
+  if (it == m_waitingWrites.end())
+    return;
+
+  PVRIptvCacheWriteJob *job = it->second;
+  m_waitingWrites.erase(it);
+  lock.Unlock();
+
+  if (bCopy)
+    job->m_strData = strContents;
+  else
+    job->m_strData.swap(strContents);
+  m_cacheWritePool->Add(job);
+}
+
+bool PVRIptvData::PackCachedFile(const std::string &strCachedPath, const std::string &strContents,
+                                 std::string &strPacked)
+{
+  // packed sources are stored as they are
+  if (!g_bCacheCompress || PVRIptvDecompressor::IsCompressed(strContents.c_str(), strContents.size()))
+    return false;
+
+  if (!GzipDeflate(strContents, strPacked))
+  {
+    XBMC->Log(LOG_ERROR, "Unable to compress cached file '%s'.", strCachedPath.c_str());
+    strPacked.clear();
+    return false;
+  }
+
+  return true;
+}
+
+void PVRIptvData::WriteCachedFile(const std::string &strCachedPath, const std::string &strContents, uint64_t iHash,
+                                  bool bUnchanged, const PVRIptvHttpValidators &validators)
+{
+  std::string strPacked;
+  bool bPacked = !bUnchanged && PackCachedFile(strCachedPath, strContents, strPacked);
+  WriteCacheData(strCachedPath, bPacked ? strPacked : strContents, iHash, bUnchanged, validators,
+                 NextCacheWrite(strCachedPath));
+}
+
+void PVRIptvData::WriteCacheData(const std::string &strCachedPath, const std::string &strData, uint64_t iHash,
+                                 bool bUnchanged, const PVRIptvHttpValidators &validators, unsigned int iSequence)
+{
+  // writers of a file take turns, one handed over late never replaces a newer one
+  CLockObject lock(m_cacheWriteMutex);
+  unsigned int &iWritten = m_cacheWritten[strCachedPath];
+  if (iSequence < iWritten)
+    return;
+  iWritten = iSequence;
+
+  if (!bUnchanged && !ReplaceFileContents(strCachedPath, strData))
+  {
+    XBMC->Log(LOG_ERROR, "Unable to replace cached file '%s'.", strCachedPath.c_str());
+    return;
+  }
+
+  // a server answering 304 may leave them out, the stored ones stay valid
+  if (!bUnchanged || !validators.IsEmpty())
+    PVRIptvHttp::WriteValidators(strCachedPath + CACHE_HTTP_EXTENSION, validators);
+
+  // written last, it marks the cache as complete
+  std::string strHash = StringUtils::Format("%016llx", (unsigned long long)iHash);
+  std::string strHashPath = strCachedPath + CACHE_HASH_EXTENSION;
+  void* fileHandle;
+  if ((fileHandle = XBMC->OpenFileForWrite(strHashPath.c_str(), true)) != NULL)
+  {
+    XBMC->WriteFile(fileHandle, strHash.c_str(), strHash.length());
+    XBMC->CloseFile(fileHandle);
+  }
+}
+
+int PVRIptvData::ReadCachedFile(std::string &strCachedPath, std::string &strContents, PVRIptvCacheType cacheType,
+                                uint64_t *pHash, PVRIptvMappedFile *pMapped)
+{
+  // guides are unpacked by UnpackEPG(), only when they have changed
+  size_t iLength = GetFileContents(strCachedPath, strContents, pHash, pMapped);
+  if (cacheType == IPTV_CACHE_EPG)
+    return iLength;
+
+  // an uncompressed cache is parsed as it is
+  bool bMapped = pMapped && pMapped->IsOpen();
+  const char *pData = bMapped ? pMapped->Data() : strContents.c_str();
+  if (!PVRIptvDecompressor::IsCompressed(pData, iLength))
+    return iLength;
+
+  std::string strPacked;
+  if (!bMapped)
+  {
+    strPacked.swap(strContents);
+    pData = strPacked.c_str();
+  }
+
+  bool bResult = PVRIptvDecompressor::Decompress(pData, iLength, strContents);
+  if (bMapped)
+    pMapped->Close();
+  if (!bResult)
+  {
+    XBMC->Log(LOG_ERROR, "Unable to decompress cached file '%s'.", strCachedPath.c_str());
+    strContents.clear();
+  }
+  return strContents.length();
+}
+
+bool PVRIptvData::UpdateCachedFile(const std::string &strCachedName, const std::string &strFilePath, bool &bChanged)
+{
+  std::string strContents;
+  std::string strUrl = strFilePath;
+  std::string strCachedPath = GetUserFilePath(strCachedName);
+  uint64_t iHash = 0, iCachedHash = 0;
+  bool bHaveHash = ReadCacheHash(strCachedPath + CACHE_HASH_EXTENSION, iCachedHash);
+  bool bNotModified = false;
+  PVRIptvHttpValidators validators;
+  bChanged = false;
+
+  if (IsStopped() ||
+      (DownloadFile(strUrl, strCachedPath, bHaveHash, strContents, iHash, validators, bNotModified) == 0 &&
+       !bNotModified))
+  {
+    XBMC->Log(LOG_NOTICE, "Unable to refresh '%s', keeping cached copy.", strFilePath.c_str());
+    return false;
+  }
+
+  bool bUnchanged = bNotModified || (bHaveHash && iHash == iCachedHash);
+  // already in background, the reload that follows must find the new copy
+  WriteCachedFile(strCachedPath, strContents, bNotModified ? iCachedHash : iHash, bUnchanged, validators);
+  if (bUnchanged)
+    XBMC->Log(LOG_DEBUG, "'%s' is unchanged.", strFilePath.c_str());
+
+  bChanged = !bUnchanged;
+  return true;
+}
+
+void PVRIptvData::RefreshCachedFile(const std::string &strCachedName, const std::string &strFilePath,
+                                    PVRIptvCacheType cacheType)
+{
+  // the new copy is picked up by a regular reload
+  bool bChanged;
+  if (UpdateCachedFile(strCachedName, strFilePath, bChanged) && bChanged)
+  {
+    if (cacheType == IPTV_CACHE_PLAYLIST && !IsStopped())
+    {
+      RefreshPlayList();
     }
-    return strContents.length();
+    else if (cacheType == IPTV_CACHE_EPG)
+    {
+      CLockObject lock(m_mutex);
+      RequestEPGLoad(m_iLastStart, m_iLastEnd);
+    }
+  }
+
+  CLockObject lock(m_mutex);
+  m_refreshing.erase(strCachedName);
+}
+
+void PVRIptvData::RefreshCachedFiles(const std::string &strBatchName, const std::vector<std::string> &cachedNames,
+                                     const std::vector<std::string> &filePaths)
+{
+  std::vector<PVRIptvCacheUpdateJob*> jobs;
+  PVRIptvJobPool pool(std::min<size_t>(cachedNames.size(), EPG_CHANNEL_MAX_WORKERS));
+  for (size_t iFile = 0; iFile < cachedNames.size() && iFile < filePaths.size(); iFile++)
+  {
+    PVRIptvCacheUpdateJob *job = new PVRIptvCacheUpdateJob(*this, cachedNames[iFile], filePaths[iFile]);
+    jobs.push_back(job);
+    pool.Add(job);
   }
+  pool.Wait();
 
-  return GetFileContents(strCachedPath, strContents);
+  bool bChanged = false;
+  std::vector<PVRIptvCacheUpdateJob*>::iterator job;
+  for (job = jobs.begin(); job != jobs.end(); ++job)
+  {
+    bChanged |= (*job)->m_bChanged;
+    delete *job;
+  }
+
+  // one reload for the whole batch
+  CLockObject lock(m_mutex);
+  if (bChanged && !IsStopped())
+    RequestEPGLoad(m_iLastStart, m_iLastEnd);
+  m_refreshing.erase(strBatchName);
 }
 
-void PVRIptvData::ApplyChannelsLogos()
+void PVRIptvData::ApplyChannelsLogos(std::vector<PVRIptvChannel> &channels, const std::string &strLogoPath)
 {
   std::vector<PVRIptvChannel>::iterator channel;
-  for(channel = m_channels.begin(); channel < m_channels.end(); ++channel)
+  for(channel = channels.begin(); channel < channels.end(); ++channel)
   {
     if (!channel->strTvgLogo.empty())
     {
-      if (!m_strLogoPath.empty()
+      if (!strLogoPath.empty()
         // special proto
         && channel->strTvgLogo.find("://") == std::string::npos)
-        channel->strLogoPath = PathCombine(m_strLogoPath, channel->strTvgLogo);
+        channel->strLogoPath = PathCombine(strLogoPath, channel->strTvgLogo);
       else
         channel->strLogoPath = channel->strTvgLogo;
     }
@@ -1022,13 +3129,24 @@ void PVRIptvData::ApplyChannelsLogos()
 
 void PVRIptvData::ApplyChannelsLogosFromEPG()
 {
+  CLockObject lock(m_mutex);
+  bool bUpdated = UpdateChannelsLogosFromEPG();
+  lock.Unlock();
+
+  if (bUpdated)
+    PVR->TriggerChannelUpdate();
+}
+
+bool PVRIptvData::UpdateChannelsLogosFromEPG(void)
+{
+  // must be called with m_mutex held
   bool bUpdated = false;
 
   std::vector<PVRIptvChannel>::iterator channel;
   for (channel = m_channels.begin(); channel < m_channels.end(); ++channel)
   {
     PVRIptvEpgChannel *epg;
-    if ((epg = FindEpgForChannel(*channel)) == NULL || epg->strIcon.empty())
+    if ((epg = FindEpgForChannel(m_epg, *channel)) == NULL || epg->strIcon.empty())
       continue;
 
     // 1 - prefer logo from playlist
@@ -1036,23 +3154,24 @@ void PVRIptvData::ApplyChannelsLogosFromEPG()
       continue;
 
     // 2 - prefer logo from epg
-    if (!epg->strIcon.empty() && g_iEPGLogos == 2)
+    if (!epg->strIcon.empty() && g_iEPGLogos == 2 && channel->strLogoPath != epg->strIcon)
     {
       channel->strLogoPath = epg->strIcon;
       bUpdated = true;
     }
   }
 
-  if (bUpdated)
-    PVR->TriggerChannelUpdate();
+  return bUpdated;
 }
 
 void PVRIptvData::ReaplyChannelsLogos(const char * strNewPath)
 {
   if (strlen(strNewPath) > 0)
   {
+    CLockObject lock(m_mutex);
     m_strLogoPath = strNewPath;
-    ApplyChannelsLogos();
+    ApplyChannelsLogos(m_channels, m_strLogoPath);
+    lock.Unlock();
 
     PVR->TriggerChannelUpdate();
     PVR->TriggerChannelGroupsUpdate();
@@ -1061,62 +3180,117 @@ void PVRIptvData::ReaplyChannelsLogos(const char * strNewPath)
 
 void PVRIptvData::ReloadEPG(const char * strNewPath)
 {
+  CLockObject lock(m_mutex);
   if (strNewPath != m_strXMLTVUrl)
   {
     m_strXMLTVUrl = strNewPath;
     // TODO clear epg for all channels
-
-    if (LoadEPG(m_iLastStart, m_iLastEnd))
-    {
-      for(unsigned int iChannelPtr = 0, max = m_channels.size(); iChannelPtr < max; iChannelPtr++)
-      {
-        PVRIptvChannel &myChannel = m_channels.at(iChannelPtr);
-        PVR->TriggerEpgUpdate(myChannel.iUniqueId);
-      }
-    }
+    lock.Unlock();
+    SetEPGSources();
+    lock.Lock();
+
+    // new source, forget failures of the old one
+    m_iEPGFailures         = 0;
+    m_iEPGNextAttempt      = 0;
+    m_iEPGCircuitOpenUntil = 0;
+    RequestEPGLoad(m_iLastStart, m_iLastEnd);
   }
 }
 
 void PVRIptvData::ReloadPlayList(const char * strNewPath)
 {
+  CLockObject lock(m_mutex);
   if (strNewPath != m_strM3uUrl)
   {
     m_strM3uUrl = strNewPath;
-    m_channels.clear();
+    m_bWatchesChanged = true;
+    lock.Unlock();
 
-    if (LoadPlayList())
-    {
+    RefreshPlayList();
+  }
+}
+
+void PVRIptvData::RefreshPlayList(void)
+{
+  bool bChannelsChanged, bGroupsChanged;
+  if (LoadPlayList(bChannelsChanged, bGroupsChanged))
+  {
+    if (bChannelsChanged)
       PVR->TriggerChannelUpdate();
+    if (bGroupsChanged)
       PVR->TriggerChannelGroupsUpdate();
-    }
   }
 }
 
-std::string PVRIptvData::ReadMarkerValue(std::string &strLine, const char* strMarkerName)
+void PVRIptvData::RequestEPGLoad(time_t iStart, time_t iEnd)
+{
+  // must be called with m_mutex held
+  // doesn't matter is epg loaded or not we shouldn't try to load it for same interval
+  m_iLastStart        = iStart;
+  m_iLastEnd          = iEnd;
+  m_bEPGLoadRequested = true;
+  m_epgSourcePending.assign(m_epgSourcePending.size(), true);
+  m_epgLoadEvent.Signal();
+}
+
+void PVRIptvData::SetPowerSaving(bool bPowerSaving)
+{
+  CLockObject lock(m_mutex);
+  m_bPowerSaving = bPowerSaving;
+  if (!IsBackgroundWorkPaused())
+    m_resumeEvent.Broadcast();
+}
+
+void PVRIptvData::SetPlaying(bool bPlaying)
+{
+  CLockObject lock(m_mutex);
+  m_bPlaying = bPlaying;
+  if (!IsBackgroundWorkPaused())
+    m_resumeEvent.Broadcast();
+}
+
+bool PVRIptvData::IsBackgroundWorkPaused(void)
+{
+  CLockObject lock(m_mutex);
+  return m_bPowerSaving || (m_bPlaying && m_bPauseOnPlayback);
+}
+
+bool PVRIptvData::YieldBackgroundWork(uint64_t &iSliceStart)
+{
+  if (IsStopped())
+    return false;
+
+  uint64_t iNow = GetTimeMs();
+  uint64_t iWorked = iNow - iSliceStart;
+  if (iWorked < BACKGROUND_SLICE_MS)
+    return true;
+
+  // stay idle long enough to keep within the cpu budget
+  if (m_iCpuBudget < 100)
+    CEvent::Sleep((uint32_t)(iWorked * (100 - m_iCpuBudget) / m_iCpuBudget));
+
+  while (IsBackgroundWorkPaused())
+  {
+    if (IsStopped())
+      return false;
+    m_resumeEvent.Wait(1000);
+  }
+
+  iSliceStart = GetTimeMs();
+  return !IsStopped();
+}
+
+void PVRIptvData::TriggerEpgUpdates(void)
 {
-  int iMarkerStart = (int) strLine.find(strMarkerName);
-  if (iMarkerStart >= 0)
+  std::set<int> channelIds;
   {
-    std::string strMarker = strMarkerName;
-    iMarkerStart += strMarker.length();
-    if (iMarkerStart < (int)strLine.length())
-    {
-      char cFind = ' ';
-      if (strLine[iMarkerStart] == '"')
-      {
-        cFind = '"';
-        iMarkerStart++;
-      }
-      int iMarkerEnd = (int)strLine.find(cFind, iMarkerStart);
-      if (iMarkerEnd < 0)
-      {
-        iMarkerEnd = strLine.length();
-      }
-      return strLine.substr(iMarkerStart, iMarkerEnd - iMarkerStart);
-    }
+    CLockObject lock(m_epgMergeMutex);
+    channelIds.swap(m_epgChangedChannels);
   }
 
-  return std::string("");
+  std::set<int>::iterator it;
+  for (it = channelIds.begin(); it != channelIds.end(); ++it)
+    PVR->TriggerEpgUpdate(*it);
 }
 
 int PVRIptvData::GetChannelId(const char * strChannelName, const char * strStreamUrl)
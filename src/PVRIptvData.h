@@ -23,9 +23,17 @@
  *
  */
 
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include "p8-platform/util/StdString.h"
 #include "client.h"
+#include "PVRIptvJob.h"
+#include "PVRIptvFileWatcher.h"
+#include "PVRIptvHttp.h"
+#include "PVRIptvM3uFilter.h"
+#include "PVRIptvMappedFile.h"
+#include "p8-platform/threads/mutex.h"
 #include "p8-platform/threads/threads.h"
 
 struct PVRIptvEpgEntry
@@ -54,6 +62,7 @@ struct PVRIptvEpgChannel
 struct PVRIptvChannel
 {
   bool        bRadio;
+  bool        bHasTvgId;    // strTvgId is from a tvg-id attribute, not the duration
   int         iUniqueId;
   int         iChannelNumber;
   int         iEncryptionSystem;
@@ -64,6 +73,27 @@ struct PVRIptvChannel
   std::string strTvgId;
   std::string strTvgName;
   std::string strTvgLogo;
+  std::string strInputFormat;
+};
+
+enum PVRIptvCacheType
+{
+  IPTV_CACHE_PLAYLIST,
+  IPTV_CACHE_EPG
+};
+
+/* playlist entry between the parallel and the sequential parse stage */
+struct PVRIptvM3uEntry
+{
+  PVRIptvM3uInfo    info;
+  PVRIptvM3uProperties properties;
+  PVRIptvStringRef  strUrl;
+  PVRIptvStringRef  strGroup;
+  bool              bGroupKnown;
+  bool              bPrepared;
+  uint64_t          iStreamHash;
+  uint64_t          iTvgIdHash;
+  PVRIptvChannel    channel;
 };
 
 struct PVRIptvChannelGroup
@@ -74,6 +104,12 @@ struct PVRIptvChannelGroup
   std::vector<int>  members;
 };
 
+/* group name to position in the group list */
+typedef std::unordered_map<std::string, unsigned int> PVRIptvGroupIndex;
+
+/* channel unique id to position in the channel list */
+typedef std::unordered_map<int, unsigned int> PVRIptvChannelIndex;
+
 struct PVRIptvEpgGenre
 {
   int               iGenreType;
@@ -81,6 +117,8 @@ struct PVRIptvEpgGenre
   std::string       strGenre;
 };
 
+class PVRIptvCacheWriteJob;
+
 class PVRIptvData : public P8PLATFORM::CThread
 {
 public:
@@ -97,30 +135,104 @@ public:
   virtual void      ReaplyChannelsLogos(const char * strNewPath);
   virtual void      ReloadPlayList(const char * strNewPath);
   virtual void      ReloadEPG(const char * strNewPath);
+  virtual void      SetPowerSaving(bool bPowerSaving);
+  virtual void      SetPlaying(bool bPlaying);
 
 protected:
-  virtual bool                 LoadPlayList(void);
+  virtual void                 InitialLoad(void);
+  virtual bool                 LoadPlayList(bool &bChannelsChanged, bool &bGroupsChanged);
+  virtual std::vector<std::string> GetPlayListSources(void);
+  virtual int                  LoadXtreamPlayList(const std::string &strCachedName, const std::string &strUrl,
+                                                  std::string &strContent, uint64_t &iHash);
+  virtual bool                 ParsePlayList(const std::string &strM3uUrl, const char *pData, size_t iLength, int iChannelNum,
+                                             std::vector<PVRIptvChannel> &channels, std::vector<PVRIptvChannelGroup> &groups,
+                                             PVRIptvGroupIndex &groupIndex, std::set<uint64_t> &streamHashes, std::set<uint64_t> &tvgIdHashes);
+  virtual bool                 ParsePlayListChunk(const char *pData, size_t iLength, int iEPGTimeShift, bool bConvert,
+                                                  std::vector<PVRIptvM3uEntry> &entries, PVRIptvStringRef &strLastGroup,
+                                                  bool &bGroupSeen, unsigned int &iSkipped);
+  virtual void                 PrepareM3uEntry(PVRIptvM3uEntry &entry, int iEPGTimeShift, bool bConvert);
   virtual bool                 LoadEPG(time_t iStart, time_t iEnd);
+  virtual bool                 LoadEPGSource(size_t iSource, const std::string &strXMLTVUrl, time_t iStart, time_t iEnd);
+  virtual bool                 LoadEPGChannels(size_t iSource, const std::string &strTemplate, time_t iStart, time_t iEnd);
+  virtual bool                 FetchEPG(const std::string &strCachedName, const std::string &strXMLTVUrl, std::string &data,
+                                        uint64_t &iHash, bool *pExpired = NULL);
+  virtual bool                 UnpackEPG(const std::string &strCachedName, const std::string &strXMLTVUrl,
+                                         std::string &data, std::string &strXml);
+  virtual bool                 ParseEPG(std::string &strXml, time_t iStart, time_t iEnd, std::vector<PVRIptvEpgChannel> &epgChannels);
+  virtual void                 PublishEPG(size_t iSource, std::vector<PVRIptvEpgChannel> &epgChannels);
+  virtual void                 MergeEPGSources(std::vector<PVRIptvEpgChannel> &merged);
+  virtual void                 SetEPGSources(void);
+  virtual void                 WaitForPlaylist(void);
   virtual bool                 LoadGenres(void);
-  virtual int                  GetFileContents(std::string& url, std::string &strContent);
-  virtual PVRIptvChannel*      FindChannel(const std::string &strId, const std::string &strName);
-  virtual PVRIptvChannelGroup* FindGroup(const std::string &strName);
-  virtual PVRIptvEpgChannel*   FindEpg(const std::string &strId);
-  virtual PVRIptvEpgChannel*   FindEpgForChannel(PVRIptvChannel &channel);
+  virtual int                  GetFileContents(std::string& url, std::string &strContent, uint64_t *pHash = NULL,
+                                               PVRIptvMappedFile *pMapped = NULL);
+  virtual PVRIptvChannel*      FindChannel(std::vector<PVRIptvChannel> &channels, const std::string &strId,
+                                           const std::string &strName);
+  virtual PVRIptvChannel*      FindChannelById(int iUniqueId);
+  virtual PVRIptvChannelGroup* FindGroup(std::vector<PVRIptvChannelGroup> &groups, PVRIptvGroupIndex &groupIndex,
+                                         const std::string &strName);
+  virtual PVRIptvEpgChannel*   FindEpg(std::vector<PVRIptvEpgChannel> &epg, const std::string &strId);
+  virtual PVRIptvEpgChannel*   FindEpgForChannel(std::vector<PVRIptvEpgChannel> &epg, PVRIptvChannel &channel);
   virtual bool                 FindEpgGenre(const std::string& strGenre, int& iType, int& iSubType);
   virtual int                  ParseDateTime(std::string& strDate, bool iDateFormat = true);
-  virtual bool                 GzipInflate( const std::string &compressedBytes, std::string &uncompressedBytes);
+  virtual bool                 GzipDeflate(const std::string &uncompressedBytes, std::string &compressedBytes);
   virtual int                  GetCachedFileContents(const std::string &strCachedName, const std::string &strFilePath, 
-                                                     std::string &strContent, const bool bUseCache = false);
-  virtual void                 ApplyChannelsLogos();
+                                                     std::string &strContent, const bool bUseCache = false,
+                                                     PVRIptvCacheType cacheType = IPTV_CACHE_PLAYLIST,
+                                                     uint64_t *pHash = NULL, PVRIptvMappedFile *pMapped = NULL,
+                                                     bool *pExpired = NULL);
+  virtual bool                 ReadCacheHash(const std::string &strHashPath, uint64_t &iHash);
+  virtual void                 StoreCachedFile(const std::string &strCachedPath, const std::string &strContents,
+                                               uint64_t iHash, bool bUnchanged, const PVRIptvHttpValidators &validators);
+  virtual void                 WriteCachedFile(const std::string &strCachedPath, const std::string &strContents,
+                                               uint64_t iHash, bool bUnchanged, const PVRIptvHttpValidators &validators);
+  virtual bool                 PackCachedFile(const std::string &strCachedPath, const std::string &strContents,
+                                              std::string &strPacked);
+  virtual void                 WriteCacheData(const std::string &strCachedPath, const std::string &strData,
+                                              uint64_t iHash, bool bUnchanged, const PVRIptvHttpValidators &validators,
+                                              unsigned int iSequence);
+  virtual unsigned int         NextCacheWrite(const std::string &strCachedPath);
+  virtual void                 ReleaseCachedFile(const std::string &strCachedName, std::string &strContents,
+                                                 bool bCopy = false);
+  virtual int                  DownloadFile(const std::string &strUrl, const std::string &strCachedPath, bool bConditional,
+                                            std::string &strContents, uint64_t &iHash,
+                                            PVRIptvHttpValidators &validators, bool &bNotModified);
+  virtual int                  ReadCachedFile(std::string &strCachedPath, std::string &strContents,
+                                              PVRIptvCacheType cacheType, uint64_t *pHash, PVRIptvMappedFile *pMapped);
+  virtual bool                 UpdateCachedFile(const std::string &strCachedName, const std::string &strFilePath,
+                                                bool &bChanged);
+  virtual void                 RefreshCachedFile(const std::string &strCachedName, const std::string &strFilePath,
+                                                 PVRIptvCacheType cacheType);
+  virtual void                 RefreshCachedFiles(const std::string &strBatchName, const std::vector<std::string> &cachedNames,
+                                                  const std::vector<std::string> &filePaths);
+  virtual void                 RefreshPlayList(void);
+  virtual void                 ApplyChannelsLogos(std::vector<PVRIptvChannel> &channels, const std::string &strLogoPath);
   virtual void                 ApplyChannelsLogosFromEPG();
-  virtual std::string          ReadMarkerValue(std::string &strLine, const char * strMarkerName);
+  virtual bool                 UpdateChannelsLogosFromEPG(void);
   virtual int                  GetChannelId(const char * strChannelName, const char * strStreamUrl);
+  virtual void                 RequestEPGLoad(time_t iStart, time_t iEnd);
+  virtual void                 ScheduleEPGRetry(void);
+  virtual void                 UpdateFileWatches(void);
+  virtual void                 CheckWatchedFiles(void);
+  virtual void                 TriggerEpgUpdates(void);
+  virtual bool                 IsBackgroundWorkPaused(void);
+  virtual bool                 YieldBackgroundWork(uint64_t &iSliceStart);
 
 protected:
   virtual void *Process(void);
 
 private:
+  friend class PVRIptvEpgLoadJob;
+  friend class PVRIptvPlaylistFetchJob;
+  friend class PVRIptvXtreamCategoryJob;
+  friend class PVRIptvPlaylistChunkJob;
+  friend class PVRIptvEpgSourceJob;
+  friend class PVRIptvEpgChannelJob;
+  friend class PVRIptvCacheRefreshJob;
+  friend class PVRIptvCacheUpdateJob;
+  friend class PVRIptvCacheBatchRefreshJob;
+  friend class PVRIptvCacheWriteJob;
+
   bool                              m_bTSOverride;
   int                               m_iEPGTimeShift;
   int                               m_iLastStart;
@@ -129,7 +241,60 @@ private:
   std::string                       m_strM3uUrl;
   std::string                       m_strLogoPath;
   std::vector<PVRIptvChannelGroup>  m_groups;
+  PVRIptvGroupIndex                 m_groupIndex;
   std::vector<PVRIptvChannel>       m_channels;
+  PVRIptvChannelIndex               m_channelIndex;
+  uint64_t                          m_iPlaylistKey;
+  unsigned int                      m_iChannelsGeneration;
+  PVRIptvM3uFilter                  m_filter;
   std::vector<PVRIptvEpgChannel>    m_epg;
   std::vector<PVRIptvEpgGenre>      m_genres;
+
+  /* XMLTV sources in priority order, m_epg is merged from them */
+  std::vector<std::string>                       m_xmltvSources;
+  std::vector<bool>                              m_epgSourcePending;
+  std::vector<uint64_t>                          m_epgSourceKeys;
+  std::vector<std::vector<PVRIptvEpgChannel> >   m_epgSources;
+  std::unordered_map<int, uint64_t>              m_epgChannelHashes;
+  std::set<int>                                  m_epgChangedChannels;
+  P8PLATFORM::CMutex                             m_epgMergeMutex;
+
+  /* background EPG loader state, guarded by m_mutex */
+  bool                              m_bEPGLoadRequested;
+  int                               m_iEPGFailures;
+  uint64_t                          m_iEPGNextAttempt;
+  time_t                            m_iEPGCircuitOpenUntil;
+  P8PLATFORM::CEvent                m_epgLoadEvent;
+
+  /* background work throttling */
+  int                               m_iCpuBudget;
+  bool                              m_bPauseOnPlayback;
+  bool                              m_bPowerSaving;
+  bool                              m_bPlaying;
+  P8PLATFORM::CEvent                m_resumeEvent;
+
+  bool                              m_bPlaylistLoaded;
+  P8PLATFORM::CEvent                m_playlistEvent;
+  P8PLATFORM::CMutex                m_playlistLoadMutex;
+
+  /* local files reloaded when they change, m_watcher is only used by the
+     loader thread, the flags are guarded by m_mutex */
+  PVRIptvFileWatcher                m_watcher;
+  bool                              m_bWatchesChanged;
+  bool                              m_bGenresLoaded;
+
+  /* expired caches being replaced in background, guarded by m_mutex */
+  std::set<std::string>             m_refreshing;
+  PVRIptvJobPool                   *m_refreshPool;
+  /* cache files are written by a single background worker, in order */
+  PVRIptvJobPool                   *m_cacheWritePool;
+  /* writes waiting for a load to be done with their contents and the last
+   * write made of each file, guarded by m_cacheSequenceMutex */
+  std::unordered_map<std::string, PVRIptvCacheWriteJob*>  m_waitingWrites;
+  std::unordered_map<std::string, unsigned int>           m_cacheWriteSequence;
+  P8PLATFORM::CMutex                                      m_cacheSequenceMutex;
+  /* the last write done of each file, guarded by m_cacheWriteMutex */
+  std::unordered_map<std::string, unsigned int>           m_cacheWritten;
+  P8PLATFORM::CMutex                                      m_cacheWriteMutex;
+  P8PLATFORM::CMutex                m_mutex;
 };
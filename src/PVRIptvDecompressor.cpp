@@ -0,0 +1,542 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "zlib.h"
+#include "PVRIptvDecompressor.h"
+
+#if defined(HAVE_LZMA)
+#include <lzma.h>
+#endif
+#if defined(HAVE_BZIP2)
+#include <bzlib.h>
+#endif
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#define DECOMPRESS_MIN_OUTPUT   (1024 * 1024)
+#define DECOMPRESS_MAX_SLICE    (1 << 30)       // codecs count in 32 bit
+#define TAR_BLOCK_SIZE          512
+#define TAR_MAGIC_OFFSET        257
+
+static bool IsGzip(const char *pData, size_t iLength)
+{
+  return iLength >= 3 && pData[0] == '\x1F' && pData[1] == '\x8B' && pData[2] == '\x08';
+}
+
+static bool IsXz(const char *pData, size_t iLength)
+{
+  return iLength >= 6 && memcmp(pData, "\xFD" "7zXZ\0", 6) == 0;
+}
+
+static bool IsBzip2(const char *pData, size_t iLength)
+{
+  return iLength >= 4 && memcmp(pData, "BZh", 3) == 0 && pData[3] >= '1' && pData[3] <= '9';
+}
+
+static bool IsZstd(const char *pData, size_t iLength)
+{
+  return iLength >= 4 && memcmp(pData, "\x28\xB5\x2F\xFD", 4) == 0;
+}
+
+char *PVRIptvDecompressor::GrowOutput(std::string &strOut, size_t iUsed, size_t &iAvailable)
+{
+  if (strOut.size() - iUsed < DECOMPRESS_MIN_OUTPUT / 4)
+    strOut.resize(std::max(strOut.size() * 2, iUsed + DECOMPRESS_MIN_OUTPUT));
+
+  iAvailable = std::min(strOut.size() - iUsed, (size_t)DECOMPRESS_MAX_SLICE);
+  return &strOut[iUsed];
+}
+
+/*
+ * gzip, a new member may follow the end of the previous one.
+ */
+class PVRIptvGzipDecompressor : public PVRIptvDecompressor
+{
+public:
+  PVRIptvGzipDecompressor(void) : m_bInitialized(false), m_bMemberEnded(false)
+  {
+    memset(&m_strm, 0, sizeof(m_strm));
+    m_bInitialized = inflateInit2(&m_strm, 16 + MAX_WBITS) == Z_OK;
+  }
+
+  virtual ~PVRIptvGzipDecompressor(void)
+  {
+    if (m_bInitialized)
+      inflateEnd(&m_strm);
+  }
+
+  virtual bool Write(const char *pData, size_t iLength, std::string &strOut)
+  {
+    if (!m_bInitialized)
+      return false;
+
+    size_t iUsed = strOut.size();
+    bool bResult = true;
+    while (iLength > 0 && bResult)
+    {
+      if (m_bMemberEnded)
+      {
+        // padding after the last member is ignored
+        if (!IsGzip(pData, iLength))
+          break;
+        inflateReset(&m_strm);
+        m_bMemberEnded = false;
+      }
+
+      uInt iSlice = (uInt)std::min(iLength, (size_t)DECOMPRESS_MAX_SLICE);
+      m_strm.next_in  = (Bytef *)pData;
+      m_strm.avail_in = iSlice;
+
+      while (m_strm.avail_in > 0)
+      {
+        size_t iAvailable;
+        m_strm.next_out  = (Bytef *)GrowOutput(strOut, iUsed, iAvailable);
+        m_strm.avail_out = (uInt)iAvailable;
+
+        int err = inflate(&m_strm, Z_NO_FLUSH);
+        iUsed += iAvailable - m_strm.avail_out;
+        if (err == Z_STREAM_END)
+        {
+          m_bMemberEnded = true;
+          break;
+        }
+        if (err != Z_OK && err != Z_BUF_ERROR)
+        {
+          bResult = false;
+          break;
+        }
+      }
+
+      size_t iConsumed = iSlice - m_strm.avail_in;
+      pData   += iConsumed;
+      iLength -= iConsumed;
+    }
+
+    strOut.resize(iUsed);
+    return bResult;
+  }
+
+  virtual bool Finish(std::string &)
+  {
+    return m_bMemberEnded;
+  }
+
+private:
+  z_stream m_strm;
+  bool     m_bInitialized;
+  bool     m_bMemberEnded;
+};
+
+#if defined(HAVE_LZMA)
+class PVRIptvXzDecompressor : public PVRIptvDecompressor
+{
+public:
+  PVRIptvXzDecompressor(void) : m_bInitialized(false)
+  {
+    lzma_stream strm = LZMA_STREAM_INIT;
+    m_strm = strm;
+    m_bInitialized = lzma_stream_decoder(&m_strm, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+  }
+
+  virtual ~PVRIptvXzDecompressor(void)
+  {
+    lzma_end(&m_strm);
+  }
+
+  virtual bool Write(const char *pData, size_t iLength, std::string &strOut)
+  {
+    return m_bInitialized && Decode(pData, iLength, LZMA_RUN, strOut);
+  }
+
+  virtual bool Finish(std::string &strOut)
+  {
+    // concatenated streams only end with the input
+    return m_bInitialized && Decode(NULL, 0, LZMA_FINISH, strOut);
+  }
+
+private:
+  bool Decode(const char *pData, size_t iLength, lzma_action action, std::string &strOut)
+  {
+    size_t iUsed = strOut.size();
+    m_strm.next_in  = (const uint8_t *)pData;
+    m_strm.avail_in = iLength;
+
+    lzma_ret ret = LZMA_OK;
+    while (ret == LZMA_OK && (m_strm.avail_in > 0 || action == LZMA_FINISH))
+    {
+      size_t iAvailable;
+      m_strm.next_out  = (uint8_t *)GrowOutput(strOut, iUsed, iAvailable);
+      m_strm.avail_out = iAvailable;
+
+      ret = lzma_code(&m_strm, action);
+      iUsed += iAvailable - m_strm.avail_out;
+    }
+
+    strOut.resize(iUsed);
+    return action == LZMA_FINISH ? ret == LZMA_STREAM_END : ret == LZMA_OK || ret == LZMA_STREAM_END;
+  }
+
+  lzma_stream m_strm;
+  bool        m_bInitialized;
+};
+#endif // HAVE_LZMA
+
+#if defined(HAVE_BZIP2)
+/*
+ * bzip2, parallel compressors write one stream per block.
+ */
+class PVRIptvBzip2Decompressor : public PVRIptvDecompressor
+{
+public:
+  PVRIptvBzip2Decompressor(void) : m_bInitialized(false), m_bStreamEnded(false)
+  {
+    memset(&m_strm, 0, sizeof(m_strm));
+    m_bInitialized = BZ2_bzDecompressInit(&m_strm, 0, 0) == BZ_OK;
+  }
+
+  virtual ~PVRIptvBzip2Decompressor(void)
+  {
+    if (m_bInitialized)
+      BZ2_bzDecompressEnd(&m_strm);
+  }
+
+  virtual bool Write(const char *pData, size_t iLength, std::string &strOut)
+  {
+    size_t iUsed = strOut.size();
+    bool bResult = m_bInitialized;
+    while (iLength > 0 && bResult)
+    {
+      if (m_bStreamEnded)
+      {
+        if (!IsBzip2(pData, iLength))
+          break;
+        BZ2_bzDecompressEnd(&m_strm);
+        memset(&m_strm, 0, sizeof(m_strm));
+        m_bInitialized = bResult = BZ2_bzDecompressInit(&m_strm, 0, 0) == BZ_OK;
+        m_bStreamEnded = false;
+        continue;
+      }
+
+      unsigned int iSlice = (unsigned int)std::min(iLength, (size_t)DECOMPRESS_MAX_SLICE);
+      m_strm.next_in  = (char *)pData;
+      m_strm.avail_in = iSlice;
+
+      while (m_strm.avail_in > 0)
+      {
+        size_t iAvailable;
+        m_strm.next_out  = GrowOutput(strOut, iUsed, iAvailable);
+        m_strm.avail_out = (unsigned int)iAvailable;
+
+        int err = BZ2_bzDecompress(&m_strm);
+        iUsed += iAvailable - m_strm.avail_out;
+        if (err == BZ_STREAM_END)
+        {
+          m_bStreamEnded = true;
+          break;
+        }
+        if (err != BZ_OK)
+        {
+          bResult = false;
+          break;
+        }
+      }
+
+      size_t iConsumed = iSlice - m_strm.avail_in;
+      pData   += iConsumed;
+      iLength -= iConsumed;
+    }
+
+    strOut.resize(iUsed);
+    return bResult;
+  }
+
+  virtual bool Finish(std::string &)
+  {
+    return m_bStreamEnded;
+  }
+
+private:
+  bz_stream m_strm;
+  bool      m_bInitialized;
+  bool      m_bStreamEnded;
+};
+#endif // HAVE_BZIP2
+
+#if defined(HAVE_ZSTD)
+class PVRIptvZstdDecompressor : public PVRIptvDecompressor
+{
+public:
+  PVRIptvZstdDecompressor(void) : m_iLastResult(1)
+  {
+    m_stream = ZSTD_createDStream();
+    if (m_stream && ZSTD_isError(ZSTD_initDStream(m_stream)))
+    {
+      ZSTD_freeDStream(m_stream);
+      m_stream = NULL;
+    }
+  }
+
+  virtual ~PVRIptvZstdDecompressor(void)
+  {
+    if (m_stream)
+      ZSTD_freeDStream(m_stream);
+  }
+
+  virtual bool Write(const char *pData, size_t iLength, std::string &strOut)
+  {
+    return m_stream && Decode(pData, iLength, strOut);
+  }
+
+  virtual bool Finish(std::string &strOut)
+  {
+    // flushes what the decoder still holds, 0 once the last frame is complete
+    return m_stream && Decode(NULL, 0, strOut) && m_iLastResult == 0;
+  }
+
+private:
+  bool Decode(const char *pData, size_t iLength, std::string &strOut)
+  {
+    size_t iUsed = strOut.size();
+    ZSTD_inBuffer input = { pData, iLength, 0 };
+    bool bResult = true;
+
+    // frames follow each other, the stream starts the next one by itself,
+    // after a full output the decoder may hold more even without input
+    bool bFull = true;
+    while (input.pos < input.size || bFull)
+    {
+      size_t iAvailable;
+      ZSTD_outBuffer output = { GrowOutput(strOut, iUsed, iAvailable), 0, 0 };
+      output.size = iAvailable;
+
+      m_iLastResult = ZSTD_decompressStream(m_stream, &output, &input);
+      iUsed += output.pos;
+      if (ZSTD_isError(m_iLastResult))
+      {
+        bResult = false;
+        break;
+      }
+      bFull = output.pos == output.size;
+    }
+
+    strOut.resize(iUsed);
+    return bResult;
+  }
+
+  ZSTD_DStream *m_stream;
+  size_t        m_iLastResult;
+};
+#endif // HAVE_ZSTD
+
+PVRIptvDecompressor *PVRIptvDecompressor::Create(const char *pData, size_t iLength)
+{
+  if (IsGzip(pData, iLength))
+    return new PVRIptvGzipDecompressor();
+#if defined(HAVE_LZMA)
+  if (IsXz(pData, iLength))
+    return new PVRIptvXzDecompressor();
+#endif
+#if defined(HAVE_BZIP2)
+  if (IsBzip2(pData, iLength))
+    return new PVRIptvBzip2Decompressor();
+#endif
+#if defined(HAVE_ZSTD)
+  if (IsZstd(pData, iLength))
+    return new PVRIptvZstdDecompressor();
+#endif
+  return NULL;
+}
+
+/*
+ * Also true for formats that aren't built in, so they are reported
+ * rather than parsed as text.
+ */
+bool PVRIptvDecompressor::IsCompressed(const char *pData, size_t iLength)
+{
+  return IsGzip(pData, iLength) || IsXz(pData, iLength) || IsBzip2(pData, iLength) || IsZstd(pData, iLength);
+}
+
+bool PVRIptvDecompressor::Decompress(const char *pData, size_t iLength, std::string &strOut)
+{
+  PVRIptvDecompressor *decompressor = Create(pData, iLength);
+  if (!decompressor)
+    return false;
+
+  // guides shrink about ten times, sized once for the usual case
+  strOut.clear();
+  strOut.reserve(iLength * 8);
+
+  bool bResult = decompressor->Write(pData, iLength, strOut) && decompressor->Finish(strOut);
+  delete decompressor;
+
+  if (!bResult)
+    strOut.clear();
+  return bResult;
+}
+
+/*
+ * Octal number, GNU tar stores large sizes as base 256 with the high bit
+ * set in the first byte.
+ */
+static bool ParseTarNumber(const char *pField, size_t iFieldLength, uint64_t &iValue)
+{
+  iValue = 0;
+  if ((unsigned char)pField[0] & 0x80)
+  {
+    for (size_t i = 1; i < iFieldLength; i++)
+      iValue = (iValue << 8) | (unsigned char)pField[i];
+    return true;
+  }
+
+  size_t i = 0;
+  while (i < iFieldLength && pField[i] == ' ')
+    i++;
+  for (; i < iFieldLength && pField[i] >= '0' && pField[i] <= '7'; i++)
+    iValue = (iValue << 3) | (uint64_t)(pField[i] - '0');
+  return true;
+}
+
+static bool IsTarHeader(const char *pHeader)
+{
+  uint64_t iChecksum;
+  ParseTarNumber(pHeader + 148, 8, iChecksum);
+
+  // the checksum field counts as spaces
+  uint64_t iSum = 8 * ' ';
+  for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+  {
+    if (i < 148 || i >= 156)
+      iSum += (unsigned char)pHeader[i];
+  }
+  return iSum == iChecksum;
+}
+
+static std::string GetTarField(const char *pField, size_t iFieldLength)
+{
+  const char *pEnd = (const char *)memchr(pField, '\0', iFieldLength);
+  return std::string(pField, pEnd ? pEnd - pField : iFieldLength);
+}
+
+/*
+ * Returns the "path" record of a pax extended header, "<len> path=<value>\n".
+ */
+static std::string GetPaxPath(const char *pData, size_t iLength)
+{
+  size_t iPos = 0;
+  while (iPos < iLength)
+  {
+    size_t iRecord = 0;
+    size_t i = iPos;
+    for (; i < iLength && pData[i] >= '0' && pData[i] <= '9'; i++)
+      iRecord = iRecord * 10 + (pData[i] - '0');
+    if (iRecord == 0 || iPos + iRecord > iLength || i >= iLength || pData[i] != ' ')
+      break;
+
+    std::string strRecord(pData + i + 1, pData + iPos + iRecord);
+    if (strRecord.compare(0, 5, "path=") == 0)
+      return strRecord.substr(5, strRecord.size() - 6);
+    iPos += iRecord;
+  }
+  return "";
+}
+
+/*
+ * guide.xml, also packed ones like guide.xml.gz
+ */
+static bool IsXmlName(const std::string &strName)
+{
+  std::string strLower = strName;
+  std::transform(strLower.begin(), strLower.end(), strLower.begin(), ::tolower);
+  size_t iPos = strLower.rfind(".xml");
+  return iPos != std::string::npos && (iPos + 4 == strLower.size() || strLower[iPos + 4] == '.');
+}
+
+bool PVRIptvTarReader::IsTar(const char *pData, size_t iLength)
+{
+  return iLength >= TAR_BLOCK_SIZE && memcmp(pData + TAR_MAGIC_OFFSET, "ustar", 5) == 0 && IsTarHeader(pData);
+}
+
+bool PVRIptvTarReader::FindMember(const char *pData, size_t iLength, size_t &iOffset, size_t &iSize,
+                                  std::string &strName)
+{
+  bool bFound = false;
+  std::string strLongName;
+  size_t iPos = 0;
+
+  while (iPos + TAR_BLOCK_SIZE <= iLength)
+  {
+    const char *pHeader = pData + iPos;
+
+    // the archive ends with zero blocks
+    if (pHeader[0] == '\0' || !IsTarHeader(pHeader))
+      break;
+
+    uint64_t iMemberSize;
+    ParseTarNumber(pHeader + 124, 12, iMemberSize);
+    size_t iDataOffset = iPos + TAR_BLOCK_SIZE;
+    if (iMemberSize > iLength - iDataOffset)
+      break;
+
+    char cType = pHeader[156];
+    if (cType == 'L')
+    {
+      // GNU long name of the next member
+      strLongName = GetTarField(pData + iDataOffset, (size_t)iMemberSize);
+    }
+    else if (cType == 'x')
+    {
+      strLongName = GetPaxPath(pData + iDataOffset, (size_t)iMemberSize);
+    }
+    else
+    {
+      std::string strMember = strLongName;
+      if (strMember.empty())
+      {
+        strMember = GetTarField(pHeader, 100);
+        std::string strPrefix = GetTarField(pHeader + 345, 155);
+        if (!strPrefix.empty() && memcmp(pHeader + TAR_MAGIC_OFFSET, "ustar\0", 6) == 0)
+          strMember = strPrefix + "/" + strMember;
+      }
+      strLongName.clear();
+
+      // regular files only, an .xml one wins
+      if ((cType == '0' || cType == '\0' || cType == '7') && (!bFound || IsXmlName(strMember)))
+      {
+        iOffset = iDataOffset;
+        iSize   = (size_t)iMemberSize;
+        strName = strMember;
+        bFound  = true;
+        if (IsXmlName(strMember))
+          return true;
+      }
+    }
+
+    iPos = iDataOffset + (size_t)((iMemberSize + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE);
+  }
+
+  return bFound;
+}
@@ -0,0 +1,74 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * @brief Streaming decoder of one compression format.
+ *
+ * Input may be fed in pieces of any size, the decoded bytes are appended
+ * to the output string. gzip is always available, xz, bzip2 and zstd when
+ * the addon was built with HAVE_LZMA, HAVE_BZIP2 and HAVE_ZSTD.
+ * Concatenated streams of the same format are decoded as one.
+ */
+class PVRIptvDecompressor
+{
+public:
+  virtual ~PVRIptvDecompressor(void) {}
+
+  virtual bool Write(const char *pData, size_t iLength, std::string &strOut) = 0;
+  /*!
+   * @return False when the input ended in the middle of a stream.
+   */
+  virtual bool Finish(std::string &strOut) = 0;
+
+  /*!
+   * @brief Decoder for the format of the data, detected from its first bytes.
+   * @return NULL when the data isn't compressed or the codec isn't built in.
+   */
+  static PVRIptvDecompressor *Create(const char *pData, size_t iLength);
+  static bool IsCompressed(const char *pData, size_t iLength);
+  static bool Decompress(const char *pData, size_t iLength, std::string &strOut);
+
+protected:
+  static char *GrowOutput(std::string &strOut, size_t iUsed, size_t &iAvailable);
+};
+
+/*!
+ * @brief Reader of POSIX and GNU tar archives in memory.
+ */
+class PVRIptvTarReader
+{
+public:
+  static bool IsTar(const char *pData, size_t iLength);
+
+  /*!
+   * @brief Finds the first regular file named *.xml or *.xml.<packed>, or
+   *        the first regular file when there is none, and returns where its
+   *        data is.
+   */
+  static bool FindMember(const char *pData, size_t iLength, size_t &iOffset, size_t &iSize, std::string &strName);
+};
@@ -0,0 +1,200 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "PVRIptvFileWatcher.h"
+#include "PVRIptvMappedFile.h"
+#include "client.h"
+
+#if defined(TARGET_LINUX) || defined(TARGET_ANDROID)
+#include <sys/inotify.h>
+#include <unistd.h>
+#define FILE_WATCH_INOTIFY
+#endif
+
+#define FILE_URL_PREFIX      "file://"
+#define SPECIAL_URL_PREFIX   "special://"
+
+using namespace ADDON;
+
+PVRIptvFileWatcher::PVRIptvFileWatcher(void)
+  : m_iNotifyFd(-1)
+{
+#if defined(FILE_WATCH_INOTIFY)
+  m_iNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_iNotifyFd < 0)
+    XBMC->Log(LOG_NOTICE, "inotify is not available, local files are polled.");
+#endif
+}
+
+PVRIptvFileWatcher::~PVRIptvFileWatcher(void)
+{
+#if defined(FILE_WATCH_INOTIFY)
+  if (m_iNotifyFd >= 0)
+    close(m_iNotifyFd);
+#endif
+}
+
+/*
+ * Remote sources are refreshed by the cache, only files on this machine
+ * and Kodi's special:// folders are watched.
+ */
+bool PVRIptvFileWatcher::CanWatch(const std::string &strPath)
+{
+  return PVRIptvMappedFile::IsLocalPath(strPath) ||
+         strPath.compare(0, sizeof(SPECIAL_URL_PREFIX) - 1, SPECIAL_URL_PREFIX) == 0;
+}
+
+void PVRIptvFileWatcher::Add(const std::string &strPath, int iTag)
+{
+  WatchedFile file;
+  file.strPath   = strPath;
+  file.iTag      = iTag;
+  file.iWatch    = -1;
+  file.bPending  = false;
+  file.bSettling = false;
+  file.bExists   = false;
+  file.iModified = 0;
+  file.iSize     = 0;
+  Update(file);
+
+#if defined(FILE_WATCH_INOTIFY)
+  // the directory is watched, files are usually replaced rather than rewritten
+  if (m_iNotifyFd >= 0 && PVRIptvMappedFile::IsLocalPath(strPath))
+  {
+    std::string strFile = strPath;
+    if (strFile.compare(0, sizeof(FILE_URL_PREFIX) - 1, FILE_URL_PREFIX) == 0)
+      strFile.erase(0, sizeof(FILE_URL_PREFIX) - 1);
+
+    size_t iSlash = strFile.rfind('/');
+    std::string strDir = iSlash == 0 ? "/" : strFile.substr(0, iSlash);
+    file.strName = strFile.substr(iSlash + 1);
+    file.iWatch  = inotify_add_watch(m_iNotifyFd, strDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (file.iWatch < 0)
+      XBMC->Log(LOG_NOTICE, "Unable to watch '%s', polling it.", strDir.c_str());
+  }
+#endif
+
+  m_files.push_back(file);
+}
+
+void PVRIptvFileWatcher::Clear(void)
+{
+#if defined(FILE_WATCH_INOTIFY)
+  // the same directory may be watched for several files
+  std::vector<int> watches;
+  std::vector<WatchedFile>::iterator it;
+  for (it = m_files.begin(); it != m_files.end(); ++it)
+  {
+    if (it->iWatch >= 0 && std::find(watches.begin(), watches.end(), it->iWatch) == watches.end())
+    {
+      inotify_rm_watch(m_iNotifyFd, it->iWatch);
+      watches.push_back(it->iWatch);
+    }
+  }
+#endif
+
+  m_files.clear();
+}
+
+bool PVRIptvFileWatcher::Poll(std::vector<int> &tags)
+{
+  tags.clear();
+
+#if defined(FILE_WATCH_INOTIFY)
+  if (m_iNotifyFd >= 0)
+  {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t iRead;
+    while ((iRead = read(m_iNotifyFd, buffer, sizeof(buffer))) > 0)
+    {
+      for (char *p = buffer; p < buffer + iRead; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+      {
+        const struct inotify_event *event = (const struct inotify_event *)p;
+        std::vector<WatchedFile>::iterator it;
+        for (it = m_files.begin(); it != m_files.end(); ++it)
+        {
+          // lost events, everything is checked
+          if (event->mask & IN_Q_OVERFLOW)
+            it->bPending = true;
+          else if (it->iWatch == event->wd)
+          {
+            // the directory is gone, its files are polled from now on
+            if (event->mask & IN_IGNORED)
+              it->iWatch = -1;
+            else if (event->len > 0 && it->strName == event->name)
+              it->bPending = true;
+          }
+        }
+      }
+    }
+  }
+#endif
+
+  std::vector<WatchedFile>::iterator it;
+  for (it = m_files.begin(); it != m_files.end(); ++it)
+  {
+    if (it->iWatch >= 0 && !it->bPending)
+      continue;
+
+    it->bPending = false;
+    bool bChanged = Update(*it);
+    if (it->iWatch < 0)
+    {
+      // wait until the writer is done
+      if (bChanged)
+      {
+        it->bSettling = true;
+        continue;
+      }
+      if (!it->bSettling)
+        continue;
+      it->bSettling = false;
+    }
+    else if (!bChanged)
+      continue;
+
+    if (std::find(tags.begin(), tags.end(), it->iTag) == tags.end())
+      tags.push_back(it->iTag);
+  }
+
+  return !tags.empty();
+}
+
+bool PVRIptvFileWatcher::Update(WatchedFile &file)
+{
+  struct __stat64 st;
+  memset(&st, 0, sizeof(st));
+  bool bExists = XBMC->FileExists(file.strPath.c_str(), false) && XBMC->StatFile(file.strPath.c_str(), &st) == 0;
+
+  bool bChanged = bExists != file.bExists ||
+                  (bExists && (st.st_mtime != file.iModified || st.st_size != file.iSize));
+  file.bExists   = bExists;
+  file.iModified = st.st_mtime;
+  file.iSize     = st.st_size;
+
+  // a file that is gone keeps the last content
+  return bChanged && bExists;
+}
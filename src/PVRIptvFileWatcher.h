@@ -0,0 +1,76 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+/*!
+ * @brief Notices changes of local playlist, guide and genre files.
+ *
+ * On Linux the directories of the files are watched with inotify and a
+ * file is only looked at after an event for it. Elsewhere, and for
+ * files inotify can not watch, the modification time and size are
+ * compared on every Poll(). A polled file is reported once it stayed the
+ * same for one more poll, so a file still being written is not picked
+ * up. A missing file that shows up counts as changed.
+ */
+class PVRIptvFileWatcher
+{
+public:
+  PVRIptvFileWatcher(void);
+  ~PVRIptvFileWatcher(void);
+
+  void Add(const std::string &strPath, int iTag);
+  void Clear(void);
+  bool IsEmpty(void) const { return m_files.empty(); }
+
+  /*!
+   * @brief Collects the tags of the files changed since the last call.
+   * @return True when at least one file has changed.
+   */
+  bool Poll(std::vector<int> &tags);
+
+  static bool CanWatch(const std::string &strPath);
+
+private:
+  struct WatchedFile
+  {
+    std::string strPath;
+    std::string strName;
+    int         iTag;
+    int         iWatch;
+    bool        bPending;
+    bool        bSettling;
+    bool        bExists;
+    time_t      iModified;
+    int64_t     iSize;
+  };
+
+  bool Update(WatchedFile &file);
+
+  std::vector<WatchedFile> m_files;
+  int                      m_iNotifyFd;
+};
@@ -0,0 +1,228 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <cstdlib>
+#include "PVRIptvHttp.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+
+#define HTTP_STATUS_UNKNOWN  0
+
+using namespace ADDON;
+
+bool PVRIptvHttp::IsHttpUrl(const std::string &strUrl)
+{
+  return StringUtils::StartsWithNoCase(strUrl, "http://") || StringUtils::StartsWithNoCase(strUrl, "https://");
+}
+
+void PVRIptvHttp::AppendEncoded(std::string &strUrl, const char *pData, size_t iLength)
+{
+  static const char *strHex = "0123456789ABCDEF";
+  for (size_t i = 0; i < iLength; i++)
+  {
+    unsigned char c = (unsigned char)pData[i];
+    if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+        || c == '-' || c == '_' || c == '.' || c == '~')
+      strUrl += (char)c;
+    else
+    {
+      strUrl += '%';
+      strUrl += strHex[c >> 4];
+      strUrl += strHex[c & 0x0F];
+    }
+  }
+}
+
+static int HexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+std::string PVRIptvHttp::Decode(const std::string &strValue)
+{
+  std::string strDecoded;
+  strDecoded.reserve(strValue.size());
+  for (size_t i = 0; i < strValue.size(); i++)
+  {
+    int iHigh, iLow;
+    if (strValue[i] == '%' && i + 2 < strValue.size()
+        && (iHigh = HexValue(strValue[i + 1])) >= 0 && (iLow = HexValue(strValue[i + 2])) >= 0)
+    {
+      strDecoded += (char)(iHigh << 4 | iLow);
+      i += 2;
+    }
+    else if (strValue[i] == '+')
+      strDecoded += ' ';
+    else
+      strDecoded += strValue[i];
+  }
+  return strDecoded;
+}
+
+/*
+ * Returns a response header or the status line, empty when missing.
+ */
+static std::string GetFileProperty(void *fileHandle, XFILE::FileProperty type, const char *strName)
+{
+  std::string strValue;
+  char *strProperty = XBMC->GetFilePropertyValue(fileHandle, type, strName);
+  if (strProperty)
+  {
+    strValue = strProperty;
+    XBMC->FreeString(strProperty);
+  }
+  StringUtils::Trim(strValue);
+  return strValue;
+}
+
+void *PVRIptvHttp::Open(const std::string &strUrl, const PVRIptvHttpValidators &validators, int &iStatus,
+                        int64_t iResumeFrom /* 0 */)
+{
+  iStatus = HTTP_STATUS_UNKNOWN;
+
+  void *fileHandle = XBMC->CURLCreate(strUrl.c_str());
+  if (!fileHandle)
+    return NULL;
+
+  XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER, "Connection", "keep-alive");
+  if (iResumeFrom > 0)
+  {
+    // ranges count bytes of the file as stored, it must not be re-encoded
+    std::string strRange = StringUtils::Format("bytes=%lld-", (long long)iResumeFrom);
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER, "Range", strRange.c_str());
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER, "If-Range", validators.strETag.c_str());
+  }
+  else
+  {
+    // not encoded, so the length is known, a short transfer is told from a
+    // complete one and an interrupted one can be continued
+    XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_PROTOCOL, "acceptencoding", "identity");
+    if (!validators.strETag.empty())
+      XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER, "If-None-Match", validators.strETag.c_str());
+    if (!validators.strLastModified.empty())
+      XBMC->CURLAddOption(fileHandle, XFILE::CURL_OPTION_HEADER, "If-Modified-Since", validators.strLastModified.c_str());
+  }
+
+  if (!XBMC->CURLOpen(fileHandle, READ_NO_CACHE))
+  {
+    XBMC->CloseFile(fileHandle);
+    return NULL;
+  }
+
+  // "HTTP/1.1 304 Not Modified"
+  std::string strStatus = GetFileProperty(fileHandle, XFILE::FILE_PROPERTY_RESPONSE_PROTOCOL, "");
+  size_t iSpace = strStatus.find(' ');
+  if (iSpace != std::string::npos)
+    iStatus = atoi(strStatus.c_str() + iSpace + 1);
+
+  return fileHandle;
+}
+
+void PVRIptvHttp::GetValidators(void *fileHandle, PVRIptvHttpValidators &validators)
+{
+  validators.strETag         = GetFileProperty(fileHandle, XFILE::FILE_PROPERTY_RESPONSE_HEADER, "etag");
+  validators.strLastModified = GetFileProperty(fileHandle, XFILE::FILE_PROPERTY_RESPONSE_HEADER, "last-modified");
+}
+
+/*
+ * "Content-Range: bytes 1000-4999/5000", the total is -1 when the server
+ * doesn't know it.
+ */
+bool PVRIptvHttp::GetContentRange(void *fileHandle, int64_t &iStart, int64_t &iTotal)
+{
+  std::string strRange = GetFileProperty(fileHandle, XFILE::FILE_PROPERTY_RESPONSE_HEADER, "content-range");
+  if (!StringUtils::StartsWithNoCase(strRange, "bytes "))
+    return false;
+
+  char *pEnd;
+  iStart = strtoll(strRange.c_str() + 6, &pEnd, 10);
+  if (*pEnd != '-')
+    return false;
+
+  size_t iSlash = strRange.find('/');
+  if (iSlash == std::string::npos)
+    return false;
+
+  iTotal = strRange[iSlash + 1] == '*' ? -1 : strtoll(strRange.c_str() + iSlash + 1, NULL, 10);
+  return true;
+}
+
+bool PVRIptvHttp::IsIdentityEncoded(void *fileHandle)
+{
+  std::string strEncoding = GetFileProperty(fileHandle, XFILE::FILE_PROPERTY_RESPONSE_HEADER, "content-encoding");
+  return strEncoding.empty() || StringUtils::EqualsNoCase(strEncoding, "identity");
+}
+
+/*
+ * Stored as two lines, the ETag and the Last-Modified date.
+ */
+bool PVRIptvHttp::ReadValidators(const std::string &strPath, PVRIptvHttpValidators &validators)
+{
+  validators = PVRIptvHttpValidators();
+  if (!XBMC->FileExists(strPath.c_str(), false))
+    return false;
+
+  void *fileHandle = XBMC->OpenFile(strPath.c_str(), 0);
+  if (!fileHandle)
+    return false;
+
+  char buffer[1024];
+  ssize_t iRead = XBMC->ReadFile(fileHandle, buffer, sizeof(buffer));
+  XBMC->CloseFile(fileHandle);
+  if (iRead <= 0)
+    return false;
+
+  std::string strData(buffer, iRead);
+  size_t iNewLine = strData.find('\n');
+  validators.strETag = strData.substr(0, iNewLine);
+  if (iNewLine != std::string::npos)
+    validators.strLastModified = strData.substr(iNewLine + 1);
+  StringUtils::Trim(validators.strETag);
+  StringUtils::Trim(validators.strLastModified);
+
+  return !validators.IsEmpty();
+}
+
+void PVRIptvHttp::WriteValidators(const std::string &strPath, const PVRIptvHttpValidators &validators)
+{
+  if (validators.IsEmpty())
+  {
+    XBMC->DeleteFile(strPath.c_str());
+    return;
+  }
+
+  std::string strData = validators.strETag + "\n" + validators.strLastModified + "\n";
+  void *fileHandle = XBMC->OpenFileForWrite(strPath.c_str(), true);
+  if (fileHandle)
+  {
+    XBMC->WriteFile(fileHandle, strData.c_str(), strData.length());
+    XBMC->CloseFile(fileHandle);
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <stdint.h>
+#include <string>
+
+/*!
+ * @brief Response headers of a cached download, sent back on the next
+ *        request so the server can answer 304 Not Modified.
+ */
+struct PVRIptvHttpValidators
+{
+  std::string strETag;
+  std::string strLastModified;
+
+  bool IsEmpty(void) const { return strETag.empty() && strLastModified.empty(); }
+  // weak tags can not be used to continue a download
+  bool IsStrong(void) const { return !strETag.empty() && strETag.compare(0, 2, "W/") != 0; }
+};
+
+/*!
+ * @brief HTTP requests through Kodi's curl, which keeps connections to a
+ *        host open between requests.
+ *
+ * Requests ask for gzip transfer encoding, the body read from the
+ * returned handle is already decoded.
+ */
+class PVRIptvHttp
+{
+public:
+  static bool  IsHttpUrl(const std::string &strUrl);
+  /* percent-encodes everything but the unreserved characters of RFC 3986 */
+  static void  AppendEncoded(std::string &strUrl, const char *pData, size_t iLength);
+  static std::string Decode(const std::string &strValue);
+
+  /*!
+   * @brief Opens strUrl, a conditional request when validators are given.
+   *
+   * With iResumeFrom only the rest of the file is asked for, as long as it
+   * still has the ETag of the validators. The server answers 206 with the
+   * rest or 200 with the whole new file.
+   *
+   * @return Handle to read the body from and close with XBMC->CloseFile(),
+   *         NULL on failure. A 304 answer also returns a handle, iStatus
+   *         tells them apart.
+   */
+  static void *Open(const std::string &strUrl, const PVRIptvHttpValidators &validators, int &iStatus,
+                    int64_t iResumeFrom = 0);
+  static void  GetValidators(void *fileHandle, PVRIptvHttpValidators &validators);
+  static bool  GetContentRange(void *fileHandle, int64_t &iStart, int64_t &iTotal);
+  static bool  IsIdentityEncoded(void *fileHandle);
+
+  static bool  ReadValidators(const std::string &strPath, PVRIptvHttpValidators &validators);
+  static void  WriteValidators(const std::string &strPath, const PVRIptvHttpValidators &validators);
+};
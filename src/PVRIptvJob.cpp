@@ -0,0 +1,183 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include "PVRIptvJob.h"
+
+#if defined(TARGET_LINUX) || defined(TARGET_ANDROID)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(TARGET_DARWIN)
+#include <sys/resource.h>
+#include <unistd.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace P8PLATFORM;
+
+/*
+ * Background loads compete with video decoding on slow devices,
+ * let the scheduler prefer everything else.
+ */
+void SetBackgroundThreadPriority(void)
+{
+#if defined(TARGET_WINDOWS)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(TARGET_LINUX) || defined(TARGET_ANDROID)
+  setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 10);
+#elif defined(TARGET_DARWIN)
+  setpriority(PRIO_DARWIN_THREAD, 0, PRIO_DARWIN_BG);
+#endif
+}
+
+unsigned int GetProcessorCount(void)
+{
+#if defined(TARGET_WINDOWS)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  long iCount = (long)info.dwNumberOfProcessors;
+#else
+  long iCount = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return iCount > 0 ? (unsigned int)iCount : 1;
+}
+
+class PVRIptvJobWorker : public CThread
+{
+public:
+  PVRIptvJobWorker(PVRIptvJobPool &pool) : m_pool(pool) {}
+
+protected:
+  virtual void *Process(void)
+  {
+    SetBackgroundThreadPriority();
+
+    PVRIptvJob *job;
+    while ((job = m_pool.NextJob(this)) != NULL)
+    {
+      job->Run();
+      m_pool.JobDone();
+    }
+
+    return NULL;
+  }
+
+private:
+  PVRIptvJobPool &m_pool;
+};
+
+PVRIptvJobPool::PVRIptvJobPool(unsigned int iMaxWorkers)
+{
+  m_iMaxWorkers    = iMaxWorkers > 0 ? iMaxWorkers : 1;
+  m_iActiveWorkers = 0;
+  m_iPendingJobs   = 0;
+}
+
+PVRIptvJobPool::~PVRIptvJobPool(void)
+{
+  Wait();
+
+  // the queue is empty, every worker is about to exit
+  CLockObject lock(m_mutex);
+  while (m_iActiveWorkers > 0)
+  {
+    lock.Unlock();
+    m_doneEvent.Wait(100);
+    lock.Lock();
+  }
+  ReapWorkers();
+}
+
+void PVRIptvJobPool::Add(PVRIptvJob *job)
+{
+  CLockObject lock(m_mutex);
+  m_jobs.push_back(job);
+  m_iPendingJobs++;
+
+  // long living pools would otherwise keep a thread object per busy period
+  ReapWorkers();
+
+  if (m_iActiveWorkers < m_iMaxWorkers)
+  {
+    PVRIptvJobWorker *worker = new PVRIptvJobWorker(*this);
+    m_workers.push_back(worker);
+    m_iActiveWorkers++;
+    worker->CreateThread(false);
+  }
+}
+
+void PVRIptvJobPool::Wait(void)
+{
+  CLockObject lock(m_mutex);
+  while (m_iPendingJobs > 0)
+  {
+    lock.Unlock();
+    m_doneEvent.Wait(100);
+    lock.Lock();
+  }
+}
+
+void PVRIptvJobPool::ReapWorkers(void)
+{
+  // must be called with m_mutex held, exited workers never lock it again
+  std::vector<PVRIptvJobWorker*>::iterator it;
+  for (it = m_exitedWorkers.begin(); it != m_exitedWorkers.end(); ++it)
+  {
+    (*it)->StopThread();
+    delete *it;
+  }
+  m_exitedWorkers.clear();
+}
+
+PVRIptvJob *PVRIptvJobPool::NextJob(PVRIptvJobWorker *worker)
+{
+  CLockObject lock(m_mutex);
+  if (m_jobs.empty())
+  {
+    // the worker exits, a new one is started for the next job
+    m_iActiveWorkers--;
+    std::vector<PVRIptvJobWorker*>::iterator it = std::find(m_workers.begin(), m_workers.end(), worker);
+    if (it != m_workers.end())
+    {
+      m_workers.erase(it);
+      m_exitedWorkers.push_back(worker);
+    }
+    m_doneEvent.Signal();
+    return NULL;
+  }
+
+  PVRIptvJob *job = m_jobs.front();
+  m_jobs.pop_front();
+  return job;
+}
+
+void PVRIptvJobPool::JobDone(void)
+{
+  CLockObject lock(m_mutex);
+  m_iPendingJobs--;
+  m_doneEvent.Signal();
+}
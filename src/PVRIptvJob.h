@@ -0,0 +1,76 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <deque>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+
+/*!
+ * @brief Unit of background work, run by a PVRIptvJobPool worker.
+ */
+class PVRIptvJob
+{
+public:
+  virtual ~PVRIptvJob(void) {}
+  virtual void Run(void) = 0;
+};
+
+class PVRIptvJobWorker;
+
+/*!
+ * @brief Runs jobs on a bounded number of low priority threads.
+ *        Jobs are owned by the caller and must outlive Wait(). A job that
+ *        is queued and never waited for may delete itself as the last step
+ *        of Run(), the pool does not touch it afterwards.
+ */
+class PVRIptvJobPool
+{
+public:
+  PVRIptvJobPool(unsigned int iMaxWorkers);
+  virtual ~PVRIptvJobPool(void);
+
+  virtual void Add(PVRIptvJob *job);
+  virtual void Wait(void);
+
+private:
+  friend class PVRIptvJobWorker;
+
+  PVRIptvJob *NextJob(PVRIptvJobWorker *worker);
+  void        JobDone(void);
+  void        ReapWorkers(void);
+
+  unsigned int                     m_iMaxWorkers;
+  unsigned int                     m_iActiveWorkers;
+  unsigned int                     m_iPendingJobs;
+  std::deque<PVRIptvJob*>          m_jobs;
+  std::vector<PVRIptvJobWorker*>   m_workers;
+  std::vector<PVRIptvJobWorker*>   m_exitedWorkers;
+  P8PLATFORM::CEvent               m_doneEvent;
+  P8PLATFORM::CMutex               m_mutex;
+};
+
+extern void SetBackgroundThreadPriority(void);
+extern unsigned int GetProcessorCount(void);
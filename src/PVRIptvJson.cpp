@@ -0,0 +1,335 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include "PVRIptvJson.h"
+
+#define JSON_MAX_DEPTH  64      // deeper documents are rejected instead of overflowing the stack
+
+static const PVRIptvJsonValue g_jsonNull;
+
+const PVRIptvJsonValue &PVRIptvJsonValue::operator[](size_t iIndex) const
+{
+  if (m_type != JSON_ARRAY || iIndex >= m_items.size())
+    return g_jsonNull;
+
+  return m_items[iIndex];
+}
+
+const PVRIptvJsonValue &PVRIptvJsonValue::Get(const char *strKey) const
+{
+  for (size_t i = 0; i < m_keys.size(); i++)
+  {
+    if (m_keys[i] == strKey)
+      return m_items[i];
+  }
+
+  return g_jsonNull;
+}
+
+int PVRIptvJsonValue::AsInt(void) const
+{
+  return atoi(m_strValue.c_str());
+}
+
+bool PVRIptvJson::Parse(const char *pData, size_t iLength, PVRIptvJsonValue &root)
+{
+  root = PVRIptvJsonValue();
+
+  // a BOM is not allowed, but often sent anyway
+  if (iLength >= 3 && memcmp(pData, "\xEF\xBB\xBF", 3) == 0)
+  {
+    pData   += 3;
+    iLength -= 3;
+  }
+
+  PVRIptvJson parser(pData, iLength);
+  if (!parser.ParseValue(root, 0))
+    return false;
+
+  parser.SkipWhitespace();
+  return parser.m_pPos == parser.m_pEnd;
+}
+
+void PVRIptvJson::SkipWhitespace(void)
+{
+  while (m_pPos < m_pEnd && (*m_pPos == ' ' || *m_pPos == '\t' || *m_pPos == '\r' || *m_pPos == '\n'))
+    m_pPos++;
+}
+
+bool PVRIptvJson::ParseValue(PVRIptvJsonValue &value, int iDepth)
+{
+  SkipWhitespace();
+  if (m_pPos >= m_pEnd || iDepth > JSON_MAX_DEPTH)
+    return false;
+
+  switch (*m_pPos)
+  {
+  case '{':
+    value.m_type = PVRIptvJsonValue::JSON_OBJECT;
+    m_pPos++;
+    SkipWhitespace();
+    if (m_pPos < m_pEnd && *m_pPos == '}')
+    {
+      m_pPos++;
+      return true;
+    }
+    while (true)
+    {
+      SkipWhitespace();
+      std::string strKey;
+      if (m_pPos >= m_pEnd || *m_pPos != '"' || !ParseString(strKey))
+        return false;
+
+      SkipWhitespace();
+      if (m_pPos >= m_pEnd || *m_pPos++ != ':')
+        return false;
+
+      value.m_keys.push_back(strKey);
+      value.m_items.push_back(PVRIptvJsonValue());
+      if (!ParseValue(value.m_items.back(), iDepth + 1))
+        return false;
+
+      SkipWhitespace();
+      if (m_pPos >= m_pEnd)
+        return false;
+      if (*m_pPos == '}')
+      {
+        m_pPos++;
+        return true;
+      }
+      if (*m_pPos++ != ',')
+        return false;
+    }
+
+  case '[':
+    value.m_type = PVRIptvJsonValue::JSON_ARRAY;
+    m_pPos++;
+    SkipWhitespace();
+    if (m_pPos < m_pEnd && *m_pPos == ']')
+    {
+      m_pPos++;
+      return true;
+    }
+    while (true)
+    {
+      value.m_items.push_back(PVRIptvJsonValue());
+      if (!ParseValue(value.m_items.back(), iDepth + 1))
+        return false;
+
+      SkipWhitespace();
+      if (m_pPos >= m_pEnd)
+        return false;
+      if (*m_pPos == ']')
+      {
+        m_pPos++;
+        return true;
+      }
+      if (*m_pPos++ != ',')
+        return false;
+    }
+
+  case '"':
+    value.m_type = PVRIptvJsonValue::JSON_STRING;
+    return ParseString(value.m_strValue);
+
+  case 't':
+    value.m_type = PVRIptvJsonValue::JSON_BOOL;
+    value.m_strValue = "true";
+    return ParseLiteral("true");
+
+  case 'f':
+    value.m_type = PVRIptvJsonValue::JSON_BOOL;
+    value.m_strValue = "false";
+    return ParseLiteral("false");
+
+  case 'n':
+    value.m_type = PVRIptvJsonValue::JSON_NULL;
+    return ParseLiteral("null");
+
+  default:
+    value.m_type = PVRIptvJsonValue::JSON_NUMBER;
+    return ParseNumber(value.m_strValue);
+  }
+}
+
+bool PVRIptvJson::ParseLiteral(const char *strLiteral)
+{
+  size_t iLength = strlen(strLiteral);
+  if ((size_t)(m_pEnd - m_pPos) < iLength || memcmp(m_pPos, strLiteral, iLength) != 0)
+    return false;
+
+  m_pPos += iLength;
+  return true;
+}
+
+static bool IsDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+bool PVRIptvJson::ParseNumber(std::string &strValue)
+{
+  const char *pStart = m_pPos;
+
+  if (m_pPos < m_pEnd && *m_pPos == '-')
+    m_pPos++;
+  if (m_pPos >= m_pEnd || !IsDigit(*m_pPos))
+    return false;
+  while (m_pPos < m_pEnd && IsDigit(*m_pPos))
+    m_pPos++;
+
+  if (m_pPos < m_pEnd && *m_pPos == '.')
+  {
+    m_pPos++;
+    if (m_pPos >= m_pEnd || !IsDigit(*m_pPos))
+      return false;
+    while (m_pPos < m_pEnd && IsDigit(*m_pPos))
+      m_pPos++;
+  }
+
+  if (m_pPos < m_pEnd && (*m_pPos == 'e' || *m_pPos == 'E'))
+  {
+    m_pPos++;
+    if (m_pPos < m_pEnd && (*m_pPos == '+' || *m_pPos == '-'))
+      m_pPos++;
+    if (m_pPos >= m_pEnd || !IsDigit(*m_pPos))
+      return false;
+    while (m_pPos < m_pEnd && IsDigit(*m_pPos))
+      m_pPos++;
+  }
+
+  strValue.assign(pStart, m_pPos - pStart);
+  return true;
+}
+
+bool PVRIptvJson::ParseHex4(unsigned int &iValue)
+{
+  if (m_pEnd - m_pPos < 4)
+    return false;
+
+  iValue = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    char c = *m_pPos++;
+    iValue <<= 4;
+    if (c >= '0' && c <= '9')
+      iValue |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      iValue |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      iValue |= c - 'A' + 10;
+    else
+      return false;
+  }
+
+  return true;
+}
+
+/*
+ * Appends a code point as UTF-8
+ */
+static void AppendUTF8(std::string &strValue, unsigned int iCode)
+{
+  if (iCode < 0x80)
+    strValue += (char)iCode;
+  else if (iCode < 0x800)
+  {
+    strValue += (char)(0xC0 | (iCode >> 6));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+  else if (iCode < 0x10000)
+  {
+    strValue += (char)(0xE0 | (iCode >> 12));
+    strValue += (char)(0x80 | ((iCode >> 6) & 0x3F));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+  else
+  {
+    strValue += (char)(0xF0 | (iCode >> 18));
+    strValue += (char)(0x80 | ((iCode >> 12) & 0x3F));
+    strValue += (char)(0x80 | ((iCode >> 6) & 0x3F));
+    strValue += (char)(0x80 | (iCode & 0x3F));
+  }
+}
+
+bool PVRIptvJson::ParseString(std::string &strValue)
+{
+  // opening quote
+  m_pPos++;
+
+  while (m_pPos < m_pEnd)
+  {
+    // plain runs are copied at once
+    const char *pRun = m_pPos;
+    while (m_pPos < m_pEnd && *m_pPos != '"' && *m_pPos != '\\' && (unsigned char)*m_pPos >= 0x20)
+      m_pPos++;
+    strValue.append(pRun, m_pPos - pRun);
+
+    if (m_pPos >= m_pEnd || (unsigned char)*m_pPos < 0x20)
+      return false;
+
+    if (*m_pPos++ == '"')
+      return true;
+
+    if (m_pPos >= m_pEnd)
+      return false;
+
+    unsigned int iCode;
+    switch (*m_pPos++)
+    {
+    case '"':  strValue += '"';  break;
+    case '\\': strValue += '\\'; break;
+    case '/':  strValue += '/';  break;
+    case 'b':  strValue += '\b'; break;
+    case 'f':  strValue += '\f'; break;
+    case 'n':  strValue += '\n'; break;
+    case 'r':  strValue += '\r'; break;
+    case 't':  strValue += '\t'; break;
+    case 'u':
+      if (!ParseHex4(iCode))
+        return false;
+      // a high surrogate must be followed by its low half
+      if (iCode >= 0xD800 && iCode <= 0xDBFF)
+      {
+        unsigned int iLow;
+        if (m_pEnd - m_pPos < 2 || m_pPos[0] != '\\' || m_pPos[1] != 'u')
+          return false;
+        m_pPos += 2;
+        if (!ParseHex4(iLow) || iLow < 0xDC00 || iLow > 0xDFFF)
+          return false;
+        iCode = 0x10000 + ((iCode - 0xD800) << 10) + (iLow - 0xDC00);
+      }
+      else if (iCode >= 0xDC00 && iCode <= 0xDFFF)
+        return false;
+      AppendUTF8(strValue, iCode);
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return false;
+}
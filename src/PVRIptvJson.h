@@ -0,0 +1,91 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string>
+#include <vector>
+
+/*!
+ * @brief Value of a parsed JSON document.
+ *
+ * Numbers are kept as their text, they are mostly ids that are passed on
+ * as strings. Missing members and out of range elements are null values.
+ */
+class PVRIptvJsonValue
+{
+public:
+  enum Type
+  {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+  };
+
+  PVRIptvJsonValue(void) : m_type(JSON_NULL) {}
+
+  Type                    GetType(void) const { return m_type; }
+  bool                    IsArray(void) const { return m_type == JSON_ARRAY; }
+  bool                    IsObject(void) const { return m_type == JSON_OBJECT; }
+  /* elements of an array or members of an object */
+  size_t                  Size(void) const { return m_items.size(); }
+  const PVRIptvJsonValue &operator[](size_t iIndex) const;
+  const PVRIptvJsonValue &Get(const char *strKey) const;
+  /* text of strings, numbers and booleans, empty for anything else */
+  const std::string      &AsString(void) const { return m_strValue; }
+  int                     AsInt(void) const;
+
+private:
+  friend class PVRIptvJson;
+
+  Type                          m_type;
+  std::string                   m_strValue;
+  std::vector<std::string>      m_keys;
+  std::vector<PVRIptvJsonValue> m_items;
+};
+
+/*!
+ * @brief Parses JSON (RFC 8259) from a buffer that needs no terminating
+ *        zero, e.g. a mapped file.
+ */
+class PVRIptvJson
+{
+public:
+  static bool Parse(const char *pData, size_t iLength, PVRIptvJsonValue &root);
+
+private:
+  PVRIptvJson(const char *pData, size_t iLength) : m_pPos(pData), m_pEnd(pData + iLength) {}
+
+  bool ParseValue(PVRIptvJsonValue &value, int iDepth);
+  bool ParseString(std::string &strValue);
+  bool ParseNumber(std::string &strValue);
+  bool ParseLiteral(const char *strLiteral);
+  bool ParseHex4(unsigned int &iValue);
+  void SkipWhitespace(void);
+
+  const char *m_pPos;
+  const char *m_pEnd;
+};
@@ -0,0 +1,178 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "PVRIptvM3uFilter.h"
+#include "p8-platform/util/StringUtils.h"
+
+#define M3U_FILTER_SEPARATOR    "|"
+
+static inline char LowerASCII(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+PVRIptvM3uFilter::PVRIptvM3uFilter(void)
+{
+}
+
+void PVRIptvM3uFilter::Load(const std::string &strInclude, const std::string &strExclude)
+{
+  m_include.clear();
+  m_exclude.clear();
+  ParseRules(strInclude, m_include);
+  ParseRules(strExclude, m_exclude);
+}
+
+bool PVRIptvM3uFilter::IsEmpty(void) const
+{
+  return m_include.empty() && m_exclude.empty();
+}
+
+bool PVRIptvM3uFilter::UsesGroup(void) const
+{
+  for (std::vector<Rule>::const_iterator it = m_include.begin(); it != m_include.end(); ++it)
+  {
+    if (it->field == M3U_FILTER_GROUP)
+      return true;
+  }
+  for (std::vector<Rule>::const_iterator it = m_exclude.begin(); it != m_exclude.end(); ++it)
+  {
+    if (it->field == M3U_FILTER_GROUP)
+      return true;
+  }
+
+  return false;
+}
+
+bool PVRIptvM3uFilter::Accept(const PVRIptvStringRef &strGroup, const PVRIptvStringRef &strName,
+                              const PVRIptvStringRef &strUrl) const
+{
+  if (!m_include.empty() && !MatchAny(m_include, strGroup, strName, strUrl))
+    return false;
+
+  return !MatchAny(m_exclude, strGroup, strName, strUrl);
+}
+
+bool PVRIptvM3uFilter::AcceptGroup(const PVRIptvStringRef &strGroup) const
+{
+  // a name or url rule may still include some entries
+  bool bIncluded = m_include.empty();
+  for (std::vector<Rule>::const_iterator it = m_include.begin(); it != m_include.end() && !bIncluded; ++it)
+    bIncluded = it->field != M3U_FILTER_GROUP || Match(it->strPattern, strGroup);
+  if (!bIncluded)
+    return false;
+
+  for (std::vector<Rule>::const_iterator it = m_exclude.begin(); it != m_exclude.end(); ++it)
+  {
+    if (it->field == M3U_FILTER_GROUP && Match(it->strPattern, strGroup))
+      return false;
+  }
+
+  return true;
+}
+
+void PVRIptvM3uFilter::ParseRules(const std::string &strRules, std::vector<Rule> &rules)
+{
+  std::vector<std::string> tokens = StringUtils::Split(strRules, M3U_FILTER_SEPARATOR);
+  for (std::vector<std::string>::iterator it = tokens.begin(); it != tokens.end(); ++it)
+  {
+    std::string strRule = StringUtils::Trim(*it);
+    if (strRule.empty())
+      continue;
+
+    Rule rule;
+    rule.field = M3U_FILTER_GROUP;
+    if (StringUtils::StartsWithNoCase(strRule, "group:"))
+      strRule.erase(0, 6);
+    else if (StringUtils::StartsWithNoCase(strRule, "name:"))
+    {
+      rule.field = M3U_FILTER_NAME;
+      strRule.erase(0, 5);
+    }
+    else if (StringUtils::StartsWithNoCase(strRule, "url:"))
+    {
+      rule.field = M3U_FILTER_URL;
+      strRule.erase(0, 4);
+    }
+
+    for (std::string::iterator c = strRule.begin(); c != strRule.end(); ++c)
+      *c = LowerASCII(*c);
+    rule.strPattern = strRule;
+    rules.push_back(rule);
+  }
+}
+
+bool PVRIptvM3uFilter::MatchAny(const std::vector<Rule> &rules, const PVRIptvStringRef &strGroup,
+                                const PVRIptvStringRef &strName, const PVRIptvStringRef &strUrl)
+{
+  for (std::vector<Rule>::const_iterator it = rules.begin(); it != rules.end(); ++it)
+  {
+    const PVRIptvStringRef &value = it->field == M3U_FILTER_NAME ? strName :
+                                    it->field == M3U_FILTER_URL ? strUrl : strGroup;
+    if (Match(it->strPattern, value))
+      return true;
+  }
+
+  return false;
+}
+
+/*
+ * Wildcard match without recursion, on a mismatch the last '*' takes one
+ * more character.
+ */
+bool PVRIptvM3uFilter::Match(const std::string &strPattern, const PVRIptvStringRef &value)
+{
+  const char *p = strPattern.c_str();
+  const char *pEnd = p + strPattern.size();
+  const char *v = value.pData;
+  const char *vEnd = v + value.iLength;
+  const char *pStar = NULL;
+  const char *vStar = NULL;
+
+  while (v < vEnd)
+  {
+    if (p < pEnd && *p == '*')
+    {
+      pStar = ++p;
+      vStar = v;
+    }
+    else if (p < pEnd && *p == LowerASCII(*v))
+    {
+      p++;
+      v++;
+    }
+    else if (pStar)
+    {
+      p = pStar;
+      v = ++vStar;
+    }
+    else
+      return false;
+  }
+
+  while (p < pEnd && *p == '*')
+    p++;
+
+  return p == pEnd;
+}
@@ -0,0 +1,70 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string>
+#include <vector>
+#include "PVRIptvM3uTokenizer.h"
+
+/*!
+ * @brief Include and exclude rules applied to playlist entries while parsing.
+ *
+ * Rules are separated by '|' and may start with "group:", "name:" or
+ * "url:", rules without prefix apply to the group. Patterns match the
+ * whole value, ignore ASCII case and support '*' as wildcard.
+ */
+class PVRIptvM3uFilter
+{
+public:
+  PVRIptvM3uFilter(void);
+
+  void Load(const std::string &strInclude, const std::string &strExclude);
+  bool IsEmpty(void) const;
+  bool UsesGroup(void) const;
+  bool Accept(const PVRIptvStringRef &strGroup, const PVRIptvStringRef &strName, const PVRIptvStringRef &strUrl) const;
+  /* false when the rules reject every entry of the group, whatever its name and url */
+  bool AcceptGroup(const PVRIptvStringRef &strGroup) const;
+
+private:
+  enum RuleField
+  {
+    M3U_FILTER_GROUP,
+    M3U_FILTER_NAME,
+    M3U_FILTER_URL
+  };
+
+  struct Rule
+  {
+    RuleField   field;
+    std::string strPattern;
+  };
+
+  static void ParseRules(const std::string &strRules, std::vector<Rule> &rules);
+  static bool MatchAny(const std::vector<Rule> &rules, const PVRIptvStringRef &strGroup,
+                       const PVRIptvStringRef &strName, const PVRIptvStringRef &strUrl);
+  static bool Match(const std::string &strPattern, const PVRIptvStringRef &value);
+
+  std::vector<Rule> m_include;
+  std::vector<Rule> m_exclude;
+};
@@ -0,0 +1,284 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "PVRIptvM3uTokenizer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define M3U_USE_SSE2
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define M3U_USE_NEON
+#endif
+
+#define M3U_START_MARKER        "#EXTM3U"
+#define M3U_INFO_MARKER         "#EXTINF"
+#define M3U_MARKER_LENGTH       7
+#define KODI_PROPERTY_MARKER    "#KODIPROP:"
+#define VLC_OPTION_MARKER       "#EXTVLCOPT:"
+#define UTF8_BOM                "\xEF\xBB\xBF"
+
+static inline bool IsBlank(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+static inline bool IsLineBreak(char c)
+{
+  return c == '\n' || c == '\r';
+}
+
+PVRIptvM3uTokenizer::PVRIptvM3uTokenizer(const char *pData, size_t iLength)
+{
+  m_pPos = pData;
+  m_pEnd = pData + iLength;
+
+  if (iLength >= 3 && memcmp(pData, UTF8_BOM, 3) == 0)
+    m_pPos += 3;
+}
+
+bool PVRIptvM3uTokenizer::NextLine(PVRIptvStringRef &line)
+{
+  while (m_pPos < m_pEnd)
+  {
+    const char *pStart = m_pPos;
+    const char *pBreak = (const char *)memchr(pStart, '\n', m_pEnd - pStart);
+    const char *pStop  = pBreak ? pBreak : m_pEnd;
+    m_pPos = pBreak ? pBreak + 1 : m_pEnd;
+
+    while (pStart < pStop && IsBlank(*pStart))
+      pStart++;
+    while (pStop > pStart && (IsBlank(pStop[-1]) || IsLineBreak(pStop[-1])))
+      pStop--;
+
+    if (pStop > pStart)
+    {
+      line = PVRIptvStringRef(pStart, pStop - pStart);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+PVRIptvM3uTokenizer::LineType PVRIptvM3uTokenizer::GetLineType(const PVRIptvStringRef &line)
+{
+  if (line.pData[0] != '#')
+    return M3U_LINE_URL;
+  if (line.StartsWith(M3U_INFO_MARKER, M3U_MARKER_LENGTH))
+    return M3U_LINE_INFO;
+  if (line.StartsWith(M3U_START_MARKER, M3U_MARKER_LENGTH))
+    return M3U_LINE_START;
+
+  return M3U_LINE_DIRECTIVE;
+}
+
+/*
+ * #EXTINF:<duration> key="value" key=value ...,<name>
+ * Every attribute is visited once, the name starts at the first comma
+ * outside of quotes.
+ */
+void PVRIptvM3uTokenizer::ParseInfo(const PVRIptvStringRef &line, PVRIptvM3uInfo &info)
+{
+  info = PVRIptvM3uInfo();
+
+  const char *pEnd = line.pData + line.iLength;
+  const char *p    = line.pData + (line.iLength > M3U_MARKER_LENGTH ? M3U_MARKER_LENGTH : line.iLength);
+
+  if (p < pEnd && *p == ':')
+  {
+    p++;
+    info.iDuration = PVRIptvStringRef(p, pEnd - p).ToInt();
+  }
+
+  while (p < pEnd)
+  {
+    while (p < pEnd && IsBlank(*p))
+      p++;
+    if (p == pEnd)
+      break;
+
+    if (*p == ',')
+    {
+      const char *pName = p + 1;
+      while (pName < pEnd && IsBlank(*pName))
+        pName++;
+      info.strName = PVRIptvStringRef(pName, pEnd - pName);
+      break;
+    }
+
+    const char *pKey = p;
+    while (p < pEnd && *p != '=' && *p != ',' && !IsBlank(*p))
+      p++;
+    PVRIptvStringRef key(pKey, p - pKey);
+
+    if (p == pEnd || *p != '=')
+      continue;
+
+    PVRIptvStringRef value;
+    if (++p < pEnd && *p == '"')
+    {
+      const char *pValue = ++p;
+      const char *pQuote = (const char *)memchr(pValue, '"', pEnd - pValue);
+      p = pQuote ? pQuote : pEnd;
+      value = PVRIptvStringRef(pValue, p - pValue);
+      if (p < pEnd)
+        p++;
+    }
+    else
+    {
+      const char *pValue = p;
+      while (p < pEnd && *p != ',' && !IsBlank(*p))
+        p++;
+      value = PVRIptvStringRef(pValue, p - pValue);
+    }
+
+    if (key.Equals("tvg-id", 6))
+      info.strTvgId = value;
+    else if (key.Equals("tvg-name", 8))
+      info.strTvgName = value;
+    else if (key.Equals("tvg-logo", 8))
+      info.strTvgLogo = value;
+    else if (key.Equals("tvg-chno", 8))
+      info.strTvgChno = value;
+    else if (key.Equals("tvg-shift", 9))
+      info.strTvgShift = value;
+    else if (key.Equals("group-title", 11))
+      info.strGroupTitle = value;
+    else if (key.Equals("radio", 5))
+      info.strRadio = value;
+  }
+}
+
+/*
+ * #KODIPROP:<key>=<value> and #EXTVLCOPT:<key>=<value>, unknown keys are
+ * ignored.
+ */
+void PVRIptvM3uTokenizer::ParseProperty(const PVRIptvStringRef &line, PVRIptvM3uProperties &properties)
+{
+  bool bKodi = line.StartsWith(KODI_PROPERTY_MARKER, sizeof(KODI_PROPERTY_MARKER) - 1);
+  bool bVlc  = line.StartsWith(VLC_OPTION_MARKER, sizeof(VLC_OPTION_MARKER) - 1);
+  if (!bKodi && !bVlc)
+    return;
+
+  size_t iOffset = bKodi ? sizeof(KODI_PROPERTY_MARKER) - 1 : sizeof(VLC_OPTION_MARKER) - 1;
+  const char *pKey = line.pData + iOffset;
+  const char *pEnd = line.pData + line.iLength;
+  const char *pEqual = (const char *)memchr(pKey, '=', pEnd - pKey);
+  if (pEqual == NULL)
+    return;
+
+  PVRIptvStringRef key(pKey, pEqual - pKey);
+  PVRIptvStringRef value(pEqual + 1, pEnd - pEqual - 1);
+
+  if (bKodi && key.Equals("mimetype", 8))
+    properties.strMimeType = value;
+  else if (bKodi && key.Equals("inputstream.adaptive.manifest_type", 34))
+    properties.strManifestType = value;
+  else if (bVlc && key.Equals("http-user-agent", 15))
+    properties.strUserAgent = value;
+  else if (bVlc && key.Equals("http-referrer", 13))
+    properties.strReferrer = value;
+}
+
+/*
+ * Length of the ASCII run at the start of the buffer, 16 bytes at a time
+ * where the CPU allows it.
+ */
+static size_t SkipASCII(const unsigned char *p, size_t iLength)
+{
+  size_t i = 0;
+#if defined(M3U_USE_SSE2)
+  for (; i + 16 <= iLength; i += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(p + i));
+    if (_mm_movemask_epi8(chunk) != 0)
+      break;
+  }
+#elif defined(M3U_USE_NEON)
+  for (; i + 16 <= iLength; i += 16)
+  {
+    if (vmaxvq_u8(vld1q_u8(p + i)) >= 0x80)
+      break;
+  }
+#endif
+  while (i < iLength && p[i] < 0x80)
+    i++;
+  return i;
+}
+
+/*
+ * Strict UTF-8 validation: no overlong forms, no surrogates, nothing
+ * above U+10FFFF. Plain ASCII is valid UTF-8.
+ */
+bool PVRIptvM3uTokenizer::IsUTF8(const char *pData, size_t iLength)
+{
+  const unsigned char *p = (const unsigned char *)pData;
+  size_t i = 0;
+
+  while (i < iLength)
+  {
+    i += SkipASCII(p + i, iLength - i);
+    if (i == iLength)
+      break;
+
+    unsigned char c = p[i];
+    size_t iFollow;
+    unsigned char cMin = 0x80, cMax = 0xBF;
+
+    if (c >= 0xC2 && c <= 0xDF)
+      iFollow = 1;
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      iFollow = 2;
+      if (c == 0xE0)
+        cMin = 0xA0;
+      else if (c == 0xED)
+        cMax = 0x9F;
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      iFollow = 3;
+      if (c == 0xF0)
+        cMin = 0x90;
+      else if (c == 0xF4)
+        cMax = 0x8F;
+    }
+    else
+      return false;
+
+    if (iLength - i <= iFollow)
+      return false;
+    if (p[i + 1] < cMin || p[i + 1] > cMax)
+      return false;
+    for (size_t j = 2; j <= iFollow; j++)
+    {
+      if (p[i + j] < 0x80 || p[i + j] > 0xBF)
+        return false;
+    }
+    i += iFollow + 1;
+  }
+
+  return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/*!
+ * @brief Non owning view into a playlist buffer, iLength bytes from pData,
+ *        not NUL terminated.
+ */
+struct PVRIptvStringRef
+{
+  const char *pData;
+  size_t      iLength;
+
+  PVRIptvStringRef(void) : pData(""), iLength(0) {}
+  PVRIptvStringRef(const char *data, size_t length) : pData(data), iLength(length) {}
+
+  bool        empty(void) const { return iLength == 0; }
+  std::string str(void) const { return std::string(pData, iLength); }
+  bool        Equals(const char *strValue, size_t iValueLength) const
+  {
+    return iLength == iValueLength && memcmp(pData, strValue, iLength) == 0;
+  }
+  bool        StartsWith(const char *strPrefix, size_t iPrefixLength) const
+  {
+    return iLength >= iPrefixLength && memcmp(pData, strPrefix, iPrefixLength) == 0;
+  }
+
+  /* only the first iLength bytes belong to the value, the C parsers read
+   * a NUL terminated copy of them */
+  int         ToInt(void) const { char buffer[32]; return atoi(Terminate(buffer, sizeof(buffer))); }
+  double      ToDouble(void) const { char buffer[32]; return atof(Terminate(buffer, sizeof(buffer))); }
+
+private:
+  // the data may end at a mapped file's last byte, numbers are converted from a copy
+  const char *Terminate(char *buffer, size_t iSize) const
+  {
+    size_t iCopy = iLength < iSize - 1 ? iLength : iSize - 1;
+    memcpy(buffer, pData, iCopy);
+    buffer[iCopy] = '\0';
+    return buffer;
+  }
+};
+
+/*!
+ * @brief Attributes of an #EXTM3U or #EXTINF line.
+ */
+struct PVRIptvM3uInfo
+{
+  int              iDuration;
+  PVRIptvStringRef strName;
+  PVRIptvStringRef strTvgId;
+  PVRIptvStringRef strTvgName;
+  PVRIptvStringRef strTvgLogo;
+  PVRIptvStringRef strTvgChno;
+  PVRIptvStringRef strTvgShift;
+  PVRIptvStringRef strGroupTitle;
+  PVRIptvStringRef strRadio;
+};
+
+/*!
+ * @brief Stream hints from #KODIPROP and #EXTVLCOPT lines of an entry.
+ */
+struct PVRIptvM3uProperties
+{
+  PVRIptvStringRef strMimeType;
+  PVRIptvStringRef strManifestType;
+  PVRIptvStringRef strUserAgent;
+  PVRIptvStringRef strReferrer;
+};
+
+/*!
+ * @brief Walks a playlist buffer once, line by line, without copying it.
+ *        The buffer is given by pointer and length, it needs no terminator
+ *        and is never read past its end. It must outlive the tokenizer and
+ *        the string refs it returns.
+ */
+class PVRIptvM3uTokenizer
+{
+public:
+  enum LineType
+  {
+    M3U_LINE_START,
+    M3U_LINE_INFO,
+    M3U_LINE_DIRECTIVE,
+    M3U_LINE_URL
+  };
+
+  PVRIptvM3uTokenizer(const char *pData, size_t iLength);
+
+  bool            NextLine(PVRIptvStringRef &line);
+  static LineType GetLineType(const PVRIptvStringRef &line);
+  static void     ParseInfo(const PVRIptvStringRef &line, PVRIptvM3uInfo &info);
+  static void     ParseProperty(const PVRIptvStringRef &line, PVRIptvM3uProperties &properties);
+  static bool     IsUTF8(const char *pData, size_t iLength);
+
+private:
+  const char *m_pPos;
+  const char *m_pEnd;
+};
@@ -0,0 +1,165 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "PVRIptvMappedFile.h"
+
+#if defined(TARGET_WINDOWS)
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FILE_URL_PREFIX "file://"
+
+PVRIptvMappedFile::PVRIptvMappedFile(void)
+  : m_pData(NULL), m_iSize(0)
+#if defined(TARGET_WINDOWS)
+  , m_hFile(NULL), m_hMapping(NULL)
+#endif
+{
+}
+
+PVRIptvMappedFile::~PVRIptvMappedFile(void)
+{
+  Close();
+}
+
+/*
+ * Kodi VFS urls (special://, smb://, http:// ...) are left to the VFS,
+ * only absolute paths and file:// urls are opened directly.
+ */
+bool PVRIptvMappedFile::IsLocalPath(const std::string &strPath)
+{
+  if (strPath.compare(0, sizeof(FILE_URL_PREFIX) - 1, FILE_URL_PREFIX) == 0)
+    return true;
+#if defined(TARGET_WINDOWS)
+  // drive letter or UNC path
+  if (strPath.size() >= 3 && strPath[1] == ':' && (strPath[2] == '\\' || strPath[2] == '/'))
+    return true;
+  return strPath.compare(0, 2, "\\\\") == 0;
+#else
+  return !strPath.empty() && strPath[0] == '/';
+#endif
+}
+
+/*
+ * A mapped file must not be truncated under the reader, it is written
+ * aside and moved over the old one. Readers keep the old contents.
+ */
+bool PVRIptvMappedFile::Replace(const std::string &strFromPath, const std::string &strToPath)
+{
+#if defined(TARGET_WINDOWS)
+  return MoveFileExA(strFromPath.c_str(), strToPath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return rename(strFromPath.c_str(), strToPath.c_str()) == 0;
+#endif
+}
+
+bool PVRIptvMappedFile::Open(const std::string &strPath)
+{
+  Close();
+
+  std::string strFile = strPath;
+  if (strFile.compare(0, sizeof(FILE_URL_PREFIX) - 1, FILE_URL_PREFIX) == 0)
+    strFile.erase(0, sizeof(FILE_URL_PREFIX) - 1);
+
+#if defined(TARGET_WINDOWS)
+  HANDLE hFile = CreateFileA(strFile.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > (size_t)-1)
+  {
+    CloseHandle(hFile);
+    return false;
+  }
+
+  HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  void *pData = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+  if (!pData)
+  {
+    if (hMapping)
+      CloseHandle(hMapping);
+    CloseHandle(hFile);
+    return false;
+  }
+
+  m_hFile    = hFile;
+  m_hMapping = hMapping;
+  m_pData    = (const char *)pData;
+  m_iSize    = (size_t)size.QuadPart;
+#else
+  int fd = open(strFile.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+      (unsigned long long)st.st_size > (size_t)-1)
+  {
+    close(fd);
+    return false;
+  }
+
+  void *pData = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file referenced
+  close(fd);
+  if (pData == MAP_FAILED)
+    return false;
+
+  // read ahead aggressively, pages are touched front to back once
+  madvise(pData, (size_t)st.st_size, MADV_SEQUENTIAL);
+  madvise(pData, (size_t)st.st_size, MADV_WILLNEED);
+
+  m_pData = (const char *)pData;
+  m_iSize = (size_t)st.st_size;
+#endif
+
+  return true;
+}
+
+void PVRIptvMappedFile::Close(void)
+{
+  if (!m_pData)
+    return;
+
+#if defined(TARGET_WINDOWS)
+  UnmapViewOfFile(m_pData);
+  CloseHandle(m_hMapping);
+  CloseHandle(m_hFile);
+  m_hMapping = NULL;
+  m_hFile    = NULL;
+#else
+  munmap((void *)m_pData, m_iSize);
+#endif
+
+  m_pData = NULL;
+  m_iSize = 0;
+}
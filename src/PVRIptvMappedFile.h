@@ -0,0 +1,64 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <cstddef>
+#include <string>
+
+/*!
+ * @brief Read only view of a local file mapped into memory.
+ *
+ * Pages are read by the kernel on first access, the mapping is advised as
+ * sequential so the file is read ahead while it is parsed. Only plain
+ * filesystem paths can be mapped, see IsLocalPath(). Accessing the mapping
+ * of a file truncated meanwhile faults, so only files replaced whole, see
+ * Replace(), should be mapped.
+ */
+class PVRIptvMappedFile
+{
+public:
+  PVRIptvMappedFile(void);
+  ~PVRIptvMappedFile(void);
+
+  bool Open(const std::string &strPath);
+  void Close(void);
+
+  const char *Data(void) const { return m_pData; }
+  size_t      Size(void) const { return m_iSize; }
+  bool        IsOpen(void) const { return m_pData != NULL; }
+
+  static bool IsLocalPath(const std::string &strPath);
+  static bool Replace(const std::string &strFromPath, const std::string &strToPath);
+
+private:
+  PVRIptvMappedFile(const PVRIptvMappedFile &);
+  PVRIptvMappedFile &operator=(const PVRIptvMappedFile &);
+
+  const char *m_pData;
+  size_t      m_iSize;
+#if defined(TARGET_WINDOWS)
+  void       *m_hFile;
+  void       *m_hMapping;
+#endif
+};
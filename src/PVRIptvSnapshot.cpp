@@ -0,0 +1,195 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "PVRIptvSnapshot.h"
+
+#define SNAPSHOT_MAGIC          "IPTVSNAP"
+#define SNAPSHOT_MAGIC_LENGTH   8
+#define SNAPSHOT_VERSION        3
+
+template<typename T>
+static void WriteValue(std::string &strData, T value)
+{
+  strData.append((const char *)&value, sizeof(T));
+}
+
+static void WriteString(std::string &strData, const std::string &strValue)
+{
+  WriteValue<uint32_t>(strData, strValue.size());
+  strData.append(strValue);
+}
+
+/*
+ * Bounds checked reader, any short read fails the whole snapshot.
+ */
+class SnapshotReader
+{
+public:
+  SnapshotReader(const std::string &strData) : m_pPos(strData.data()), m_pEnd(strData.data() + strData.size()) {}
+
+  template<typename T>
+  bool ReadValue(T &value)
+  {
+    if ((size_t)(m_pEnd - m_pPos) < sizeof(T))
+      return false;
+    memcpy(&value, m_pPos, sizeof(T));
+    m_pPos += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string &strValue)
+  {
+    uint32_t iLength;
+    if (!ReadValue(iLength) || (size_t)(m_pEnd - m_pPos) < iLength)
+      return false;
+    strValue.assign(m_pPos, iLength);
+    m_pPos += iLength;
+    return true;
+  }
+
+  bool ReadMagic(void)
+  {
+    if ((size_t)(m_pEnd - m_pPos) < SNAPSHOT_MAGIC_LENGTH || memcmp(m_pPos, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) != 0)
+      return false;
+    m_pPos += SNAPSHOT_MAGIC_LENGTH;
+    return true;
+  }
+
+  bool AtEnd(void) const { return m_pPos == m_pEnd; }
+
+private:
+  const char *m_pPos;
+  const char *m_pEnd;
+};
+
+void PVRIptvSnapshot::Write(uint64_t iKey, const std::vector<PVRIptvChannel> &channels,
+                            const std::vector<PVRIptvChannelGroup> &groups, std::string &strData)
+{
+  strData.clear();
+  strData.append(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH);
+  WriteValue<uint32_t>(strData, SNAPSHOT_VERSION);
+  WriteValue<uint64_t>(strData, iKey);
+
+  WriteValue<uint32_t>(strData, channels.size());
+  std::vector<PVRIptvChannel>::const_iterator channel;
+  for (channel = channels.begin(); channel != channels.end(); ++channel)
+  {
+    WriteValue<uint8_t>(strData, channel->bRadio ? 1 : 0);
+    WriteValue<uint8_t>(strData, channel->bHasTvgId ? 1 : 0);
+    WriteValue<int32_t>(strData, channel->iUniqueId);
+    WriteValue<int32_t>(strData, channel->iChannelNumber);
+    WriteValue<int32_t>(strData, channel->iEncryptionSystem);
+    WriteValue<int32_t>(strData, channel->iTvgShift);
+    WriteString(strData, channel->strChannelName);
+    WriteString(strData, channel->strLogoPath);
+    WriteString(strData, channel->strStreamURL);
+    WriteString(strData, channel->strTvgId);
+    WriteString(strData, channel->strTvgName);
+    WriteString(strData, channel->strTvgLogo);
+    WriteString(strData, channel->strInputFormat);
+  }
+
+  WriteValue<uint32_t>(strData, groups.size());
+  std::vector<PVRIptvChannelGroup>::const_iterator group;
+  for (group = groups.begin(); group != groups.end(); ++group)
+  {
+    WriteValue<uint8_t>(strData, group->bRadio ? 1 : 0);
+    WriteValue<int32_t>(strData, group->iGroupId);
+    WriteString(strData, group->strGroupName);
+    WriteValue<uint32_t>(strData, group->members.size());
+    std::vector<int>::const_iterator member;
+    for (member = group->members.begin(); member != group->members.end(); ++member)
+      WriteValue<int32_t>(strData, *member);
+  }
+}
+
+bool PVRIptvSnapshot::Read(const std::string &strData, uint64_t iKey, std::vector<PVRIptvChannel> &channels,
+                           std::vector<PVRIptvChannelGroup> &groups)
+{
+  SnapshotReader reader(strData);
+  uint32_t iVersion, iCount;
+  uint64_t iSnapshotKey;
+
+  if (!reader.ReadMagic() || !reader.ReadValue(iVersion) || iVersion != SNAPSHOT_VERSION
+      || !reader.ReadValue(iSnapshotKey) || iSnapshotKey != iKey || !reader.ReadValue(iCount))
+    return false;
+
+  channels.clear();
+  groups.clear();
+
+  // every channel takes at least 46 bytes, a broken count can't allocate much
+  channels.reserve(std::min((size_t)iCount, strData.size() / 46));
+  for (uint32_t i = 0; i < iCount; i++)
+  {
+    channels.push_back(PVRIptvChannel());
+    PVRIptvChannel &channel = channels.back();
+    uint8_t  bRadio, bHasTvgId;
+    int32_t  iUniqueId, iChannelNumber, iEncryptionSystem, iTvgShift;
+
+    if (!reader.ReadValue(bRadio) || !reader.ReadValue(bHasTvgId) || !reader.ReadValue(iUniqueId) || !reader.ReadValue(iChannelNumber)
+        || !reader.ReadValue(iEncryptionSystem) || !reader.ReadValue(iTvgShift)
+        || !reader.ReadString(channel.strChannelName) || !reader.ReadString(channel.strLogoPath)
+        || !reader.ReadString(channel.strStreamURL) || !reader.ReadString(channel.strTvgId)
+        || !reader.ReadString(channel.strTvgName) || !reader.ReadString(channel.strTvgLogo)
+        || !reader.ReadString(channel.strInputFormat))
+      return false;
+
+    channel.bRadio            = bRadio != 0;
+    channel.bHasTvgId         = bHasTvgId != 0;
+    channel.iUniqueId         = iUniqueId;
+    channel.iChannelNumber    = iChannelNumber;
+    channel.iEncryptionSystem = iEncryptionSystem;
+    channel.iTvgShift         = iTvgShift;
+  }
+
+  if (!reader.ReadValue(iCount))
+    return false;
+
+  for (uint32_t i = 0; i < iCount; i++)
+  {
+    groups.push_back(PVRIptvChannelGroup());
+    PVRIptvChannelGroup &group = groups.back();
+    uint8_t  bRadio;
+    int32_t  iGroupId;
+    uint32_t iMembers;
+
+    if (!reader.ReadValue(bRadio) || !reader.ReadValue(iGroupId) || !reader.ReadString(group.strGroupName)
+        || !reader.ReadValue(iMembers))
+      return false;
+
+    group.bRadio   = bRadio != 0;
+    group.iGroupId = iGroupId;
+    for (uint32_t j = 0; j < iMembers; j++)
+    {
+      int32_t iMember;
+      if (!reader.ReadValue(iMember) || iMember < 0 || iMember >= (int32_t)channels.size())
+        return false;
+      group.members.push_back(iMember);
+    }
+  }
+
+  return reader.AtEnd();
+}
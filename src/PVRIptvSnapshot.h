@@ -0,0 +1,45 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string>
+#include <vector>
+#include "PVRIptvData.h"
+
+/*!
+ * @brief Binary image of a parsed channel list, written after a playlist
+ *        load so the next start can skip parsing.
+ *
+ * The image is only meant for the machine that wrote it, numbers are
+ * stored in native byte order. iKey identifies the playlists and settings
+ * it was built from, Read() rejects an image with another key.
+ */
+class PVRIptvSnapshot
+{
+public:
+  static void Write(uint64_t iKey, const std::vector<PVRIptvChannel> &channels,
+                    const std::vector<PVRIptvChannelGroup> &groups, std::string &strData);
+  static bool Read(const std::string &strData, uint64_t iKey, std::vector<PVRIptvChannel> &channels,
+                   std::vector<PVRIptvChannelGroup> &groups);
+};
@@ -0,0 +1,194 @@
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "PVRIptvXtream.h"
+#include "PVRIptvHttp.h"
+#include "PVRIptvJson.h"
+#include "p8-platform/util/StringUtils.h"
+
+#define XTREAM_API_NAME         "player_api.php"
+#define XTREAM_RADIO_TYPE       "radio_streams"
+
+bool PVRIptvXtream::IsXtreamUrl(const std::string &strUrl)
+{
+  if (!PVRIptvHttp::IsHttpUrl(strUrl))
+    return false;
+
+  std::string strPath = strUrl.substr(0, strUrl.find_first_of("?|"));
+  return StringUtils::EndsWithNoCase(strPath, "/" XTREAM_API_NAME);
+}
+
+bool PVRIptvXtream::Load(const std::string &strUrl)
+{
+  std::string strAddress = strUrl;
+  size_t iPos = strAddress.find('|');
+  m_strOptions.clear();
+  if (iPos != std::string::npos)
+  {
+    m_strOptions = strAddress.substr(iPos);
+    strAddress.erase(iPos);
+  }
+
+  std::string strQuery;
+  iPos = strAddress.find('?');
+  if (iPos != std::string::npos)
+  {
+    strQuery = strAddress.substr(iPos + 1);
+    strAddress.erase(iPos);
+  }
+  m_strServer = strAddress.substr(0, strAddress.size() - (sizeof(XTREAM_API_NAME) - 1));
+
+  std::string strUsername, strPassword, strOutput;
+  std::vector<std::string> arguments = StringUtils::Split(strQuery, "&");
+  std::vector<std::string>::iterator it;
+  for (it = arguments.begin(); it != arguments.end(); ++it)
+  {
+    size_t iEquals = it->find('=');
+    if (iEquals == std::string::npos)
+      continue;
+
+    std::string strName = it->substr(0, iEquals);
+    std::string strValue = it->substr(iEquals + 1);
+    if (strName == "username")
+      strUsername = strValue;
+    else if (strName == "password")
+      strPassword = strValue;
+    else if (strName == "output")
+      strOutput = PVRIptvHttp::Decode(strValue);
+  }
+
+  if (strUsername.empty() || strPassword.empty())
+    return false;
+
+  m_strCredentials = "username=" + strUsername + "&password=" + strPassword;
+
+  // streams take the credentials as path segments
+  std::string strUser = PVRIptvHttp::Decode(strUsername);
+  std::string strPass = PVRIptvHttp::Decode(strPassword);
+  m_strStreamPath = "live/";
+  PVRIptvHttp::AppendEncoded(m_strStreamPath, strUser.c_str(), strUser.size());
+  m_strStreamPath += '/';
+  PVRIptvHttp::AppendEncoded(m_strStreamPath, strPass.c_str(), strPass.size());
+  m_strStreamPath += '/';
+
+  m_strExtension = StringUtils::EqualsNoCase(strOutput, "m3u8") || StringUtils::EqualsNoCase(strOutput, "hls") ?
+                   "m3u8" : "ts";
+  return true;
+}
+
+std::string PVRIptvXtream::GetApiUrl(const std::string &strAction) const
+{
+  return m_strServer + XTREAM_API_NAME "?" + m_strCredentials + "&action=" + strAction + m_strOptions;
+}
+
+std::string PVRIptvXtream::GetCategoriesUrl(void) const
+{
+  return GetApiUrl("get_live_categories");
+}
+
+std::string PVRIptvXtream::GetStreamsUrl(const std::string &strCategoryId) const
+{
+  std::string strAction = "get_live_streams&category_id=";
+  PVRIptvHttp::AppendEncoded(strAction, strCategoryId.c_str(), strCategoryId.size());
+  return GetApiUrl(strAction);
+}
+
+bool PVRIptvXtream::ParseCategories(const char *pData, size_t iLength, std::vector<PVRIptvXtreamCategory> &categories)
+{
+  // failed logins are answered with an object
+  PVRIptvJsonValue root;
+  if (!PVRIptvJson::Parse(pData, iLength, root) || !root.IsArray())
+    return false;
+
+  for (size_t i = 0; i < root.Size(); i++)
+  {
+    PVRIptvXtreamCategory category;
+    category.strId   = root[i].Get("category_id").AsString();
+    category.strName = root[i].Get("category_name").AsString();
+    if (!category.strId.empty())
+      categories.push_back(category);
+  }
+
+  return true;
+}
+
+/*
+ * Quotes and line breaks would end the attribute or the #EXTINF line
+ */
+static void AppendM3uValue(std::string &strM3u, const std::string &strValue)
+{
+  for (std::string::const_iterator c = strValue.begin(); c != strValue.end(); ++c)
+  {
+    if (*c == '"')
+      strM3u += '\'';
+    else if (*c == '\r' || *c == '\n')
+      strM3u += ' ';
+    else
+      strM3u += *c;
+  }
+}
+
+static void AppendM3uAttribute(std::string &strM3u, const char *strName, const std::string &strValue)
+{
+  strM3u += ' ';
+  strM3u += strName;
+  strM3u += "=\"";
+  AppendM3uValue(strM3u, strValue);
+  strM3u += '"';
+}
+
+bool PVRIptvXtream::AppendStreams(const char *pData, size_t iLength, const std::string &strGroup,
+                                  std::string &strM3u) const
+{
+  PVRIptvJsonValue root;
+  if (!PVRIptvJson::Parse(pData, iLength, root) || !root.IsArray())
+    return false;
+
+  // the same entries the panel's m3u_plus export has
+  for (size_t i = 0; i < root.Size(); i++)
+  {
+    const PVRIptvJsonValue &stream = root[i];
+    const std::string &strStreamId = stream.Get("stream_id").AsString();
+    if (strStreamId.empty())
+      continue;
+
+    const std::string &strName = stream.Get("name").AsString();
+    strM3u += "#EXTINF:-1";
+    AppendM3uAttribute(strM3u, "tvg-id", stream.Get("epg_channel_id").AsString());
+    AppendM3uAttribute(strM3u, "tvg-name", strName);
+    AppendM3uAttribute(strM3u, "tvg-logo", stream.Get("stream_icon").AsString());
+    AppendM3uAttribute(strM3u, "group-title", strGroup);
+    if (stream.Get("stream_type").AsString() == XTREAM_RADIO_TYPE)
+      AppendM3uAttribute(strM3u, "radio", "true");
+    strM3u += ',';
+    AppendM3uValue(strM3u, strName);
+    strM3u += '\n';
+
+    strM3u += m_strServer + m_strStreamPath;
+    PVRIptvHttp::AppendEncoded(strM3u, strStreamId.c_str(), strStreamId.size());
+    strM3u += '.' + m_strExtension + m_strOptions + '\n';
+  }
+
+  return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+/*
+ *      Copyright (C) 2013-2015 Anton Fedchin
+ *      http://github.com/afedchin/xbmc-addon-iptvsimple/
+ *
+ *      Copyright (C) 2011 Pulse-Eight
+ *      http://www.pulse-eight.com/
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with XBMC; see the file COPYING.  If not, write to
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string>
+#include <vector>
+
+struct PVRIptvXtreamCategory
+{
+  std::string strId;
+  std::string strName;
+};
+
+/*!
+ * @brief Live channels of an Xtream Codes style panel, read per category
+ *        through its JSON API instead of the full M3U export.
+ *
+ * The source is the API address, e.g.
+ * http://host:port/player_api.php?username=...&password=...
+ * An "output=m3u8" argument asks for HLS instead of MPEG-TS streams,
+ * Kodi options after '|' are sent with every request and stream.
+ */
+class PVRIptvXtream
+{
+public:
+  static bool IsXtreamUrl(const std::string &strUrl);
+
+  bool        Load(const std::string &strUrl);
+  std::string GetCategoriesUrl(void) const;
+  std::string GetStreamsUrl(const std::string &strCategoryId) const;
+
+  static bool ParseCategories(const char *pData, size_t iLength, std::vector<PVRIptvXtreamCategory> &categories);
+  /* appends the streams of a category as playlist entries */
+  bool        AppendStreams(const char *pData, size_t iLength, const std::string &strGroup, std::string &strM3u) const;
+
+private:
+  std::string GetApiUrl(const std::string &strAction) const;
+
+  std::string m_strServer;        // everything before player_api.php
+  std::string m_strCredentials;   // username and password arguments as given
+  std::string m_strStreamPath;    // live/<username>/<password>/
+  std::string m_strExtension;
+  std::string m_strOptions;
+};
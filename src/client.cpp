@@ -50,14 +50,25 @@ CHelper_libXBMC_addon *XBMC = NULL;
 CHelper_libXBMC_pvr   *PVR  = NULL;
 
 std::string g_strTvgPath    = "";
+std::string g_strTvgExtraPaths = "";
 std::string g_strM3UPath    = "";
+std::string g_strM3UExtraPaths = "";
+std::string g_strM3UIncludeFilter = "";
+std::string g_strM3UExcludeFilter = "";
 std::string g_strLogoPath   = "";
 int         g_iEPGTimeShift = 0;
 int         g_iStartNumber  = 1;
+int         g_iM3UNumberOffset = 1000;
+int         g_iChannelIdMode   = 0;
 bool        g_bTSOverride   = true;
 bool        g_bCacheM3U     = false;
 bool        g_bCacheEPG     = false;
 int         g_iEPGLogos     = 0;
+int         g_iBackgroundCpuBudget = 100;
+int         g_iCacheTtl            = 60;
+bool        g_bCacheStaleRevalidate = true;
+bool        g_bCacheCompress       = true;
+bool        g_bPauseOnPlayback     = false;
 
 extern std::string PathCombine(const std::string &strPath, const std::string &strFileName)
 {
@@ -86,6 +97,44 @@ extern std::string GetUserFilePath(const std::string &strFileName)
   return PathCombine(g_strUserPath, strFileName);
 }
 
+/*
+ * Names of the files in the user folder that start with strPrefix
+ */
+extern std::vector<std::string> GetUserFiles(const std::string &strPrefix)
+{
+  std::vector<std::string> files;
+  VFSDirEntry *items = NULL;
+  unsigned int iCount = 0;
+  if (!XBMC->GetDirectory(g_strUserPath.c_str(), "", &items, &iCount))
+    return files;
+
+  for (unsigned int i = 0; i < iCount; i++)
+  {
+    if (items[i].folder || !items[i].path)
+      continue;
+
+    std::string strName = items[i].path;
+    size_t iPos = strName.find_last_of("/\\");
+    if (iPos != std::string::npos)
+      strName.erase(0, iPos + 1);
+    if (strName.compare(0, strPrefix.size(), strPrefix) == 0)
+      files.push_back(strName);
+  }
+  XBMC->FreeDirectory(items, iCount);
+
+  return files;
+}
+
+extern void DeleteUserFile(const std::string &strFileName)
+{
+  std::string strFile = GetUserFilePath(strFileName);
+#ifdef TARGET_WINDOWS
+  DeleteFile(strFile.c_str());
+#else
+  XBMC->DeleteFile(strFile.c_str());
+#endif
+}
+
 extern "C" {
 
 void ADDON_ReadSettings(void)
@@ -119,6 +168,26 @@ void ADDON_ReadSettings(void)
   {
     g_iStartNumber = 1;
   }
+  if (XBMC->GetSetting("m3uExtraPaths", &buffer))
+  {
+    g_strM3UExtraPaths = buffer;
+  }
+  if (!XBMC->GetSetting("m3uNumberOffset", &g_iM3UNumberOffset))
+  {
+    g_iM3UNumberOffset = 1000;
+  }
+  if (!XBMC->GetSetting("channelIdMode", &g_iChannelIdMode))
+  {
+    g_iChannelIdMode = 0;
+  }
+  if (XBMC->GetSetting("m3uIncludeFilter", &buffer))
+  {
+    g_strM3UIncludeFilter = buffer;
+  }
+  if (XBMC->GetSetting("m3uExcludeFilter", &buffer))
+  {
+    g_strM3UExcludeFilter = buffer;
+  }
   if (!XBMC->GetSetting("epgPathType", &iPathType)) 
   {
     iPathType = 1;
@@ -142,6 +211,10 @@ void ADDON_ReadSettings(void)
     }
     g_bCacheEPG = false;
   }
+  if (XBMC->GetSetting("epgExtraPaths", &buffer))
+  {
+    g_strTvgExtraPaths = buffer;
+  }
   float fShift;
   if (XBMC->GetSetting("epgTimeShift", &fShift))
   {
@@ -163,6 +236,18 @@ void ADDON_ReadSettings(void)
   // Logos from EPG
   if (!XBMC->GetSetting("logoFromEpg", &g_iEPGLogos))
     g_iEPGLogos = 0;
+
+  // Background loading
+  if (!XBMC->GetSetting("bgCpuBudget", &g_iBackgroundCpuBudget))
+    g_iBackgroundCpuBudget = 100;
+  if (!XBMC->GetSetting("bgPauseOnPlayback", &g_bPauseOnPlayback))
+    g_bPauseOnPlayback = false;
+  if (!XBMC->GetSetting("cacheTtl", &g_iCacheTtl))
+    g_iCacheTtl = 60;
+  if (!XBMC->GetSetting("cacheStaleRevalidate", &g_bCacheStaleRevalidate))
+    g_bCacheStaleRevalidate = true;
+  if (!XBMC->GetSetting("cacheCompress", &g_bCacheCompress))
+    g_bCacheCompress = true;
 }
 
 ADDON_STATUS ADDON_Create(void* hdl, void* props)
@@ -227,27 +312,14 @@ void ADDON_Destroy()
 
 ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
 {
-  // reset cache and restart addon 
+  // reset the caches of all sources, with their side files, and restart addon
+  std::vector<std::string> files = GetUserFiles(M3U_FILE_PREFIX);
+  std::vector<std::string> guides = GetUserFiles(TVG_FILE_PREFIX);
+  files.insert(files.end(), guides.begin(), guides.end());
 
-  std::string strFile = GetUserFilePath(M3U_FILE_NAME);
-  if (XBMC->FileExists(strFile.c_str(), false))
-  {
-#ifdef TARGET_WINDOWS
-    DeleteFile(strFile.c_str());
-#else
-    XBMC->DeleteFile(strFile.c_str());
-#endif
-  }
-
-  strFile = GetUserFilePath(TVG_FILE_NAME);
-  if (XBMC->FileExists(strFile.c_str(), false))
-  {
-#ifdef TARGET_WINDOWS
-    DeleteFile(strFile.c_str());
-#else
-    XBMC->DeleteFile(strFile.c_str());
-#endif
-  }
+  std::vector<std::string>::iterator it;
+  for (it = files.begin(); it != files.end(); ++it)
+    DeleteUserFile(*it);
 
   return ADDON_STATUS_NEED_RESTART;
 }
@@ -270,10 +342,14 @@ void OnSystemWake()
 
 void OnPowerSavingActivated()
 {
+  if (m_data)
+    m_data->SetPowerSaving(true);
 }
 
 void OnPowerSavingDeactivated()
 {
+  if (m_data)
+    m_data->SetPowerSaving(false);
 }
 
 const char* GetPVRAPIVersion(void)
@@ -372,6 +448,7 @@ bool OpenLiveStream(const PVR_CHANNEL &channel)
     if (m_data->GetChannel(channel, m_currentChannel))
     {
       m_bIsPlaying = true;
+      m_data->SetPlaying(true);
       return true;
     }
   }
@@ -382,6 +459,8 @@ bool OpenLiveStream(const PVR_CHANNEL &channel)
 void CloseLiveStream(void)
 {
   m_bIsPlaying = false;
+  if (m_data)
+    m_data->SetPlaying(false);
 }
 
 bool SwitchChannel(const PVR_CHANNEL &channel)
@@ -23,11 +23,14 @@
  *
  */
 
+#include <string>
+#include <vector>
 #include "libXBMC_addon.h"
 #include "libXBMC_pvr.h"
 
-#define M3U_FILE_NAME          "iptv.m3u.cache"
-#define TVG_FILE_NAME          "xmltv.xml.cache"
+/* cached playlists, guides and their side files start with these */
+#define M3U_FILE_PREFIX        "iptv."
+#define TVG_FILE_PREFIX        "xmltv."
 
 /*!
  * @brief PVR macros for string exchange
@@ -42,15 +45,28 @@ extern ADDON::CHelper_libXBMC_addon *XBMC;
 extern CHelper_libXBMC_pvr          *PVR;
 
 extern std::string g_strM3UPath;
+extern std::string g_strM3UExtraPaths;
+extern std::string g_strM3UIncludeFilter;
+extern std::string g_strM3UExcludeFilter;
 extern std::string g_strTvgPath;
+extern std::string g_strTvgExtraPaths;
 extern std::string g_strLogoPath;
 extern int         g_iEPGTimeShift;
 extern int         g_iStartNumber;
+extern int         g_iM3UNumberOffset;
+extern int         g_iChannelIdMode;
 extern bool        g_bTSOverride;
 extern bool        g_bCacheM3U;
 extern bool        g_bCacheEPG;
+extern int         g_iCacheTtl;
+extern bool        g_bCacheStaleRevalidate;
+extern bool        g_bCacheCompress;
 extern int         g_iEPGLogos;
+extern int         g_iBackgroundCpuBudget;
+extern bool        g_bPauseOnPlayback;
 
 extern std::string PathCombine(const std::string &strPath, const std::string &strFileName);
 extern std::string GetClientFilePath(const std::string &strFileName);
 extern std::string GetUserFilePath(const std::string &strFileName);
+extern std::vector<std::string> GetUserFiles(const std::string &strPrefix);
+extern void DeleteUserFile(const std::string &strFileName);